@@ -0,0 +1,253 @@
+// microbenchmarks of the solver kernels on synthetic spectra
+//
+//      bench [kernel]
+//
+// first checks that the vector overlap kernels agree with get_overlap.
+// every kernel is run a few times to warm up and then timed over a number of
+// samples. setup work (restoring the input a kernel modifies) is done between
+// samples and isn't timed. prints the median and the fastest sample per
+// operation and the throughput of the median. an operation is one call of a
+// kernel, except for the graph kernels which count edges
+
+// the kernels are internal to the solver, so it is compiled right in
+#include "sbh.cpp"
+
+#include <algorithm>
+
+#define BENCH_WARMUP  2
+#define BENCH_SAMPLES 11
+
+char *bench_filter;
+// results are summed into it, so the timed loops can't be optimized away
+volatile s32 bench_sink;
+
+template <typename Setup, typename Run>
+void bench(char *kernel, s32 n, s32 k, s64 ops, Setup setup, Run run) {
+    if (bench_filter && !strstr(kernel, bench_filter)) return;
+
+    double samples[BENCH_SAMPLES];
+    for (s32 i = 0; i < BENCH_WARMUP + BENCH_SAMPLES; i++) {
+        setup();
+        u64 start = stm_now();
+        run();
+        u64 ticks = stm_since(start);
+        if (i >= BENCH_WARMUP) samples[i - BENCH_WARMUP] = stm_ns(ticks) / ops;
+    }
+    std::sort(samples, samples + BENCH_SAMPLES);
+    double median = samples[BENCH_SAMPLES/2];
+    printf("%s;%d;%d;%.2f;%.2f;%.3f\n", kernel, n, k, median, samples[0],
+           median > 0 ? 1000 / median : 0);
+    fflush(stdout);
+}
+
+// the spectrum of a random sequence without errors, in random order
+Spectrum synthetic_spectrum(s32 n, s32 k, Rng *rng) {
+    static char nucleotides[] = "ACGT";
+    s32 sequence_length = n + k - 1;
+    char *sequence = (char *)malloc(sequence_length);
+    for (s32 i = 0; i < sequence_length; i++) {
+        sequence[i] = nucleotides[rng_next(rng) & 3];
+    }
+    s32 *order = (s32 *)malloc(n * sizeof(s32));
+    for (s32 i = 0; i < n; i++) order[i] = i;
+    for (s32 i = n-1; i > 0; i--) {
+        s32 j = rng_next(rng) % (i+1);
+        s32 t = order[i]; order[i] = order[j]; order[j] = t;
+    }
+
+    Spectrum spectrum = {};
+    spectrum.onct_length = k;
+    spectrum.stride = k;
+    spectrum.count = n;
+    spectrum.decoded = (char *)malloc((size_t)n * k);
+    spectrum.data = spectrum.decoded;
+    for (s32 i = 0; i < n; i++) {
+        memcpy(spectrum_oligo(&spectrum, i), sequence + order[i], k);
+    }
+    free(order);
+    free(sequence);
+    return spectrum;
+}
+
+void bench_spectrum(s32 n, s32 k) {
+    Rng rng = rng_seed(n * 1000 + k);
+    Spectrum spectrum = synthetic_spectrum(n, k, &rng);
+    s32 node_count = n + 1;
+    size_t size = graph_size(node_count);
+    // the graph and the table optimize_graph takes while it runs
+    size_t arena_size = align_up(size, ARENA_ALIGNMENT) + optimize_graph_size(node_count);
+    Phase_Times times = {};
+
+    bench("get_overlap", n, k, (s64)n * n, []{}, [&] {
+        s32 sum = 0;
+        for (s32 i = 0; i < n; i++) {
+            for (s32 j = 0; j < n; j++) {
+                sum += get_overlap(spectrum_oligo(&spectrum, i),
+                                   spectrum_oligo(&spectrum, j), k);
+            }
+        }
+        bench_sink = sum;
+    });
+
+    // the kernel build_edges uses, on sources padded the way it pads them
+    Overlap_Kernel overlap_of = overlap_kernel(k);
+    char (*padded)[OVERLAP_PADDING] = (char (*)[OVERLAP_PADDING])calloc(n, OVERLAP_PADDING);
+    for (s32 i = 0; i < n; i++) memcpy(padded[i], spectrum_oligo(&spectrum, i), k);
+    if (overlap_of != get_overlap) bench("overlap_kernel", n, k, (s64)n * n, []{}, [&] {
+        s32 sum = 0;
+        for (s32 i = 0; i < n; i++) {
+            for (s32 j = 0; j < n; j++) {
+                sum += overlap_of(padded[i], spectrum_oligo(&spectrum, j), k);
+            }
+        }
+        bench_sink = sum;
+    });
+    free(padded);
+
+    Arena arena = {};
+    arena_begin(&arena, arena_size);
+    // per edge
+    bench("build_graph", n, k, (s64)n * (n-1), [&] { arena_begin(&arena, arena_size); }, [&] {
+        build_graph(&spectrum, n, &arena, &times);
+    });
+    bench("build_graph_tasks", n, k, (s64)n * (n-1), [&] { arena_begin(&arena, arena_size); }, [&] {
+        build_graph(&spectrum, n, &arena, &times, 0, true);
+    });
+
+    // the graph before optimize_graph, and a copy with every node's edges
+    // shuffled for the sort
+    Node *sorted = (Node *)malloc(size);
+    Node *shuffled = (Node *)malloc(size);
+    Node *work = (Node *)malloc(size);
+    build_edges(&spectrum, sorted, &times);
+    copy_graph(shuffled, sorted, node_count);
+    s64 edge_count = 0;
+    for (s32 node_i = 0; node_i < node_count; node_i++) {
+        Node *node = &shuffled[node_i];
+        for (s32 i = node->edge_count-1; i > 0; i--) {
+            s32 j = rng_next(&rng) % (i+1);
+            Edge t = node->edges[i]; node->edges[i] = node->edges[j]; node->edges[j] = t;
+        }
+        edge_count += node->edge_count;
+    }
+
+    bench("edge_sort", n, k, edge_count, [&] { copy_graph(work, shuffled, node_count); }, [&] {
+        for (s32 node_i = 1; node_i < node_count; node_i++) {
+            qsort(work[node_i].edges, work[node_i].edge_count, sizeof(Edge), edge_cost_cmp);
+        }
+    });
+
+    bench("optimize_graph", n, k, edge_count, [&] {
+        copy_graph(work, sorted, node_count);
+        arena_begin(&arena, arena_size);
+    }, [&] {
+        optimize_graph(work+1, node_count-1, &arena);
+    });
+
+    // a population of random candidates on the optimized graph
+    arena_begin(&arena, arena_size);
+    Graph graph = build_graph(&spectrum, n, &arena, &times);
+    Solve_Params params = default_params(0);
+    s32 population = params.population;
+    s32 parent_count = params.parent_count;
+    s32 candidate_size = node_count * sizeof(Edge);
+    u8 *pristine = (u8 *)malloc((size_t)population * candidate_size);
+    u8 *candidates = (u8 *)malloc((size_t)population * candidate_size);
+    for (s32 candidate_i = 0; candidate_i < population; candidate_i++) {
+        Edge *candidate = (Edge *)(pristine + candidate_i*candidate_size);
+        for (s32 i = 0; i < node_count; i++) {
+            Node node = graph.nodes[i];
+            candidate[i] = node.edge_count ? node.edges[rng_next(&rng) % node.edge_count] : Edge{};
+        }
+    }
+    auto restore = [&] { memcpy(candidates, pristine, (size_t)population * candidate_size); };
+
+    bench("optimize_and_score", n, k, population, restore, [&] {
+        for (s32 candidate_i = 0; candidate_i < population; candidate_i++) {
+            Edge *candidate = (Edge *)(candidates + candidate_i*candidate_size);
+            optimize_and_score(candidate, graph.nodes, k, graph.max_solution_length, node_count);
+        }
+    });
+
+    // the scores of the population, as the GA has them when it breeds
+    Score *scores = (Score *)malloc(population * sizeof(Score));
+    for (s32 candidate_i = 0; candidate_i < population; candidate_i++) {
+        Edge *candidate = (Edge *)(candidates + candidate_i*candidate_size);
+        memcpy(candidate, pristine + candidate_i*candidate_size, candidate_size);
+        scores[candidate_i].oncts = optimize_and_score(candidate, graph.nodes, k,
+                                                       graph.max_solution_length, node_count);
+        scores[candidate_i].index = candidate_i;
+        scores[candidate_i].hash = candidate_hash(candidate, node_count);
+    }
+
+    // a child the way the GA breeds one, its mutations included. mutate needs
+    // a node to mutate
+    if (graph.to_mutate_count) bench("crossover", n, k, population - parent_count, restore, [&] {
+        for (s32 candidate_i = parent_count; candidate_i < population; candidate_i++) {
+            breed_candidate(candidates, scores, candidate_i, candidate_size, &graph, graph.nodes,
+                            &params, &rng, false);
+        }
+    });
+
+    s64 mutations = (s64)(population - parent_count) * params.mutations;
+    if (graph.to_mutate_count) bench("mutation", n, k, mutations, restore, [&] {
+        for (s32 candidate_i = parent_count; candidate_i < population; candidate_i++) {
+            Edge *candidate = (Edge *)(candidates + candidate_i*candidate_size);
+            mutate(candidate, &graph, graph.nodes, params.mutations, &rng);
+        }
+    });
+
+    free(scores);
+    free(candidates);
+    free(pristine);
+    free(work);
+    free(shuffled);
+    free(sorted);
+    arena_free(&arena);
+    free_spectrum(&spectrum);
+}
+
+// the vector kernels have to give exactly the overlaps of get_overlap. oligos
+// over fewer nucleotides overlap more, so every shift gets exercised
+bool verify_overlap_kernels() {
+    static char nucleotides[] = "ACGT";
+    Rng rng = rng_seed(1);
+    char oligos[64][OVERLAP_PADDING];
+    for (s32 k = 1; k <= OVERLAP_PADDING; k++) {
+        Overlap_Kernel kernel = overlap_kernel(k);
+        for (s32 alphabet = 1; alphabet <= 4; alphabet++) {
+            memset(oligos, 0, sizeof(oligos));
+            for (s32 i = 0; i < 64; i++) {
+                for (s32 j = 0; j < k; j++) oligos[i][j] = nucleotides[rng_next(&rng) % alphabet];
+            }
+            for (s32 i = 0; i < 64; i++) {
+                for (s32 j = 0; j < 64; j++) {
+                    s32 expected = get_overlap(oligos[i], oligos[j], k);
+                    s32 overlap = kernel(oligos[i], oligos[j], k);
+                    if (overlap != expected) {
+                        fprintf(stderr, "overlap kernel: %.*s %.*s gives %d instead of %d\n",
+                                k, oligos[i], k, oligos[j], overlap, expected);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    stm_setup();
+    bench_filter = argc > 1 ? argv[1] : 0;
+    if (!verify_overlap_kernels()) return 1;
+
+    s32 sizes[] = {128, 512, 1000};
+    s32 onct_lengths[] = {8, 10, 16, 32};
+    printf("kernel;n;k;ns/op;min ns/op;Mops/s\n");
+    for (s32 n : sizes) {
+        for (s32 k : onct_lengths) {
+            bench_spectrum(n, k);
+        }
+    }
+    return 0;
+}
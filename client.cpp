@@ -0,0 +1,175 @@
+// test client of the solver daemon
+//
+//      client SOCKET [-inline] [-repeat N] FILES...
+//
+// connects to `seq -serve -socket SOCKET`, sends every file N times without
+// waiting for answers, and prints each answer with its round trip time. at the
+// end come the latency over all requests, the throughput and the server's own
+// stats. files are sent by path, or with -inline as the bytes of a binary
+// spectrum (see seq -convert)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include <thread>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SOKOL_IMPL
+#include "sokol_time.h"
+
+#include "sbh.h"
+
+bool write_all(int fd, void *data, size_t size) {
+    u8 *bytes = (u8 *)data;
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written <= 0) return false;
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+// the whole file, for -inline
+u8 * read_file(char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    u8 *data = (u8 *)malloc(*size + 1);
+    bool ok = fread(data, 1, *size, f) == *size;
+    fclose(f);
+    if (!ok) {
+        free(data);
+        return 0;
+    }
+    return data;
+}
+
+int main(int argc, char **argv) {
+    stm_setup();
+    if (argc < 3) {
+        fprintf(stderr, "client SOCKET [-inline] [-repeat N] FILES...\n");
+        return 1;
+    }
+    char *socket_path = argv[1];
+    bool send_inline = false;
+    s32 repeat = 1;
+    char **files = (char **)malloc(argc * sizeof(char *));
+    s32 file_count = 0;
+    for (s32 arg_i = 2; arg_i < argc; arg_i++) {
+        if (!strcmp(argv[arg_i], "-inline")) {
+            send_inline = true;
+        } else if (!strcmp(argv[arg_i], "-repeat") && arg_i+1 < argc) {
+            repeat = atoi(argv[++arg_i]);
+        } else {
+            files[file_count++] = argv[arg_i];
+        }
+    }
+    if (repeat < 1) repeat = 1;
+
+    // the server resolves paths from its own directory
+    char **paths = (char **)malloc(file_count * sizeof(char *));
+    u8 **payloads = (u8 **)calloc(file_count, sizeof(u8 *));
+    size_t *payload_sizes = (size_t *)calloc(file_count, sizeof(size_t));
+    for (s32 i = 0; i < file_count; i++) {
+        paths[i] = realpath(files[i], 0);
+        if (!paths[i]) {
+            fprintf(stderr, "%s: no such file\n", files[i]);
+            return 1;
+        }
+        if (send_inline) {
+            payloads[i] = read_file(paths[i], &payload_sizes[i]);
+            bool binary = payloads[i] && payload_sizes[i] >= sizeof(Spectrum_Header) &&
+                          ((Spectrum_Header *)payloads[i])->magic == SPECTRUM_MAGIC;
+            if (!binary) {
+                fprintf(stderr, "%s: -inline takes binary spectra\n", files[i]);
+                return 1;
+            }
+        }
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", socket_path);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        fprintf(stderr, "%s: can't connect\n", socket_path);
+        return 1;
+    }
+
+    // requests go out from a thread of their own, so a full socket buffer
+    // can't block the answers coming back
+    s32 request_count = file_count * repeat;
+    u64 *sent = (u64 *)calloc(request_count, sizeof(u64));
+    u64 start_time = stm_now();
+    std::thread sender([&] {
+        for (s32 i = 0; i < request_count; i++) {
+            s32 file_i = i % file_count;
+            char line[PATH_MAX + 64];
+            if (send_inline) {
+                snprintf(line, sizeof(line), "spectrum %d 0 %zu\n", i, payload_sizes[file_i]);
+            } else {
+                snprintf(line, sizeof(line), "solve %d 0 %s\n", i, paths[file_i]);
+            }
+            sent[i] = stm_now();
+            if (!write_all(fd, line, strlen(line))) return;
+            if (send_inline && !write_all(fd, payloads[file_i], payload_sizes[file_i])) return;
+        }
+    });
+
+    FILE *in = fdopen(dup(fd), "rb");
+    char *line = 0;
+    size_t line_capacity = 0;
+    double *round_trips = (double *)malloc(request_count * sizeof(double));
+    s32 answered = 0;
+    s32 failed = 0;
+    printf("id;file;status;server_ms;round_trip_ms\n");
+    while (answered < request_count && getline(&line, &line_capacity, in) > 0) {
+        u64 now = stm_now();
+        line[strcspn(line, "\r\n")] = 0;
+        s32 id = atoi(line);
+        if (id < 0 || id >= request_count) continue;
+        // ID;ok;SCORE;QUEUE_MS;SOLVE_MS;TOTAL_MS;SEQUENCE or ID;error;MESSAGE
+        char status[16] = {};
+        char score[32] = {};
+        double total_ms = 0;
+        sscanf(line, "%*d;%15[^;];%31[^;];%*f;%*f;%lf", status, score, &total_ms);
+        bool ok = !strcmp(status, "ok");
+        if (!ok) failed++;
+        round_trips[answered++] = stm_ms(stm_diff(now, sent[id]));
+        char *message = line + strcspn(line, ";") + 1;
+        printf("%d;%s;%s;%f;%f\n", id, files[id % file_count], ok ? score : message,
+               total_ms, round_trips[answered-1]);
+    }
+    double elapsed_s = stm_sec(stm_since(start_time));
+    sender.join();
+
+    std::sort(round_trips, round_trips + answered);
+    double sum = 0;
+    for (s32 i = 0; i < answered; i++) sum += round_trips[i];
+    // nearest rank
+    auto percentile = [&](double p) {
+        s32 rank = (s32)ceil(p * answered) - 1;
+        return answered ? round_trips[std::min(std::max(rank, 0), answered-1)] : 0.0;
+    };
+    printf("requests;%d;failed;%d;mean_ms;%f;p50_ms;%f;p99_ms;%f;max_ms;%f;per_second;%f\n",
+           answered, failed, answered ? sum / answered : 0, percentile(0.5), percentile(0.99),
+           percentile(1), answered / elapsed_s);
+
+    const char *stats_request = "stats server\n";
+    if (write_all(fd, (void *)stats_request, strlen(stats_request)) &&
+        getline(&line, &line_capacity, in) > 0) {
+        printf("%s", line);
+    }
+    fclose(in);
+    close(fd);
+    return answered == request_count && !failed ? 0 : 1;
+}
@@ -0,0 +1,346 @@
+// generate.cpp - synthetic instances for the solver
+//
+//      generate out_dir [-n N] [-k K] [-class C] [-errors E] [-id I] [-seed S]
+//                       [-reference file] [-binary]
+//
+// cuts a reference sequence, random or read from a FASTA or plain text file,
+// into its n oligos of length k and adds errors of one of the classes of the
+// instance sets:
+//
+//      random_negative      E random oligos are missing
+//      random_positive      E random oligos that aren't in the sequence are added
+//      repetition_negative  E stretches of k bases are copied over other places
+//                           of the sequence, so oligos repeat and collapse
+//      positive_distortions E copies of real oligos with one base changed are
+//                           added, like hybridization with a mismatch
+//
+// the spectrum is written sorted to out_dir/I.N-E.txt (or +E for positive
+// errors, .sbh with -binary), named like the instance sets so the batch driver
+// reads n from the name, and the reference to out_dir/reference/I.N-E.fa
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <direct.h>
+#endif
+
+#include "stb.h"
+#include "sbh.h"
+
+#define GENERATE_MIN_K 8
+#define GENERATE_MAX_K 32
+
+enum Generate_Class {
+    CLASS_RANDOM_NEGATIVE,
+    CLASS_RANDOM_POSITIVE,
+    CLASS_REPETITION_NEGATIVE,
+    CLASS_POSITIVE_DISTORTIONS,
+    CLASS_COUNT,
+};
+
+char *class_names[CLASS_COUNT] = {
+    "random_negative", "random_positive", "repetition_negative", "positive_distortions",
+};
+
+u32 class_error_classes[CLASS_COUNT] = {
+    ERRORS_RANDOM_NEGATIVE, ERRORS_RANDOM_POSITIVE,
+    ERRORS_REPETITION_NEGATIVE, ERRORS_POSITIVE_WITH_DISTORTIONS,
+};
+
+// splitmix64, so that a seed always gives the same instance on every platform
+u64 next_random(u64 *state) {
+    u64 z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+u64 random_below(u64 *state, u64 limit) {
+    return next_random(state) % limit;
+}
+
+char nucleotides[] = "ACGT";
+
+s32 nucleotide_index(char c) {
+    switch (c) {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return 3;
+    }
+    return -1;
+}
+
+u64 oligo_code(char *oligo, s32 k) {
+    u64 code = 0;
+    for (s32 i = 0; i < k; i++) code = (code << 2) | nucleotide_index(oligo[i]);
+    return code;
+}
+
+void code_oligo(u64 code, s32 k, char *out) {
+    for (s32 i = 0; i < k; i++) {
+        out[i] = nucleotides[(code >> (2*(k-1-i))) & 3];
+    }
+}
+
+// the ACGT bases of a FASTA or plain text file, header lines skipped
+char * read_reference(char *path, s64 *length) {
+    size_t size;
+    char *data = (char *)stb_file(path, &size);
+    if (!data) {
+        fprintf(stderr, "%s: can't read reference\n", path);
+        return 0;
+    }
+    char *sequence = (char *)malloc(size + 1);
+    s64 sequence_length = 0;
+    bool header = false;
+    bool line_start = true;
+    for (size_t i = 0; i < size; i++) {
+        char c = data[i];
+        if (line_start && c == '>') header = true;
+        line_start = c == '\n';
+        if (line_start) header = false;
+        if (header) continue;
+        if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        if (nucleotide_index(c) >= 0) sequence[sequence_length++] = c;
+    }
+    free(data);
+    *length = sequence_length;
+    return sequence;
+}
+
+bool sorted_contains(u64 *codes, s64 count, u64 code) {
+    return std::binary_search(codes, codes + count, code);
+}
+
+// sorts and drops duplicates, returns the new count
+s64 sort_unique(u64 *codes, s64 count) {
+    std::sort(codes, codes + count);
+    return std::unique(codes, codes + count) - codes;
+}
+
+void make_dir(char *path) {
+#ifdef _MSC_VER
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "generate out_dir [-n N] [-k K] [-class C] [-errors E] [-id I] "
+                        "[-seed S] [-reference file] [-binary]\n");
+        return 1;
+    }
+    char *out_dir = argv[1];
+    s64 n = 1000;
+    s32 k = 10;
+    s32 error_class = CLASS_RANDOM_NEGATIVE;
+    s64 errors = -1;
+    s32 id = 1;
+    u64 seed = 1;
+    char *reference_path = 0;
+    bool binary = false;
+    bool n_given = false;
+    for (s32 arg_i = 2; arg_i < argc; arg_i++) {
+        if (!strcmp(argv[arg_i], "-n") && arg_i+1 < argc) {
+            n = atoll(argv[++arg_i]);
+            n_given = true;
+        } else if (!strcmp(argv[arg_i], "-k") && arg_i+1 < argc) {
+            k = atoi(argv[++arg_i]);
+        } else if (!strcmp(argv[arg_i], "-class") && arg_i+1 < argc) {
+            char *name = argv[++arg_i];
+            error_class = -1;
+            for (s32 i = 0; i < CLASS_COUNT; i++) {
+                if (!strcmp(name, class_names[i])) error_class = i;
+            }
+            if (error_class < 0) {
+                fprintf(stderr, "%s: unknown error class\n", name);
+                return 1;
+            }
+        } else if (!strcmp(argv[arg_i], "-errors") && arg_i+1 < argc) {
+            errors = atoll(argv[++arg_i]);
+        } else if (!strcmp(argv[arg_i], "-id") && arg_i+1 < argc) {
+            id = atoi(argv[++arg_i]);
+        } else if (!strcmp(argv[arg_i], "-seed") && arg_i+1 < argc) {
+            seed = strtoull(argv[++arg_i], 0, 10);
+        } else if (!strcmp(argv[arg_i], "-reference") && arg_i+1 < argc) {
+            reference_path = argv[++arg_i];
+        } else if (!strcmp(argv[arg_i], "-binary")) {
+            binary = true;
+        }
+    }
+    if (k < GENERATE_MIN_K || k > GENERATE_MAX_K) {
+        fprintf(stderr, "k must be between %d and %d\n", GENERATE_MIN_K, GENERATE_MAX_K);
+        return 1;
+    }
+    u64 random_state = seed;
+
+    //
+    // reference
+    //
+
+    char *sequence = 0;
+    if (reference_path) {
+        s64 reference_length;
+        sequence = read_reference(reference_path, &reference_length);
+        if (!sequence) return 1;
+        s64 reference_oligos = reference_length - k + 1;
+        if (!n_given) n = reference_oligos;
+        if (reference_oligos < n || n < 1) {
+            fprintf(stderr, "%s: %lld bases, too short for %lld oligos\n", reference_path,
+                    (long long)reference_length, (long long)n);
+            return 1;
+        }
+    }
+    if (n < 1 || n >= 0x7fffffff) {
+        fprintf(stderr, "n must be between 1 and %d\n", 0x7fffffff - 1);
+        return 1;
+    }
+    if (!reference_path) {
+        sequence = (char *)malloc(n + k);
+        for (s64 i = 0; i < n + k - 1; i++) {
+            sequence[i] = nucleotides[random_below(&random_state, 4)];
+        }
+    }
+    s64 sequence_length = n + k - 1;
+    if (errors < 0) errors = n / 10;
+
+    if (error_class == CLASS_REPETITION_NEGATIVE) {
+        // copy errors stretches of k bases over other places
+        for (s64 i = 0; i < errors && n > 1; i++) {
+            s64 from = random_below(&random_state, n);
+            s64 to = random_below(&random_state, n);
+            if (from == to) continue;
+            memmove(sequence + to, sequence + from, k);
+        }
+    }
+
+    //
+    // spectrum
+    //
+
+    u64 *codes = (u64 *)malloc((n + errors) * sizeof(u64));
+    for (s64 i = 0; i < n; i++) codes[i] = oligo_code(sequence + i, k);
+    s64 count = sort_unique(codes, n);
+    s64 true_count = count;
+    s64 error_count = 0;
+    char sign = '-';
+
+    switch (error_class) {
+        case CLASS_RANDOM_NEGATIVE: {
+            error_count = stb_min(errors, count - 1);
+            // shuffle the first error_count codes out, keep the rest sorted
+            for (s64 i = 0; i < error_count; i++) {
+                s64 j = i + random_below(&random_state, count - i);
+                u64 t = codes[i]; codes[i] = codes[j]; codes[j] = t;
+            }
+            memmove(codes, codes + error_count, (count - error_count) * sizeof(u64));
+            count = sort_unique(codes, count - error_count);
+        } break;
+
+        case CLASS_REPETITION_NEGATIVE: {
+            // the repeated oligos collapsed in the sort
+            error_count = n - count;
+        } break;
+
+        case CLASS_RANDOM_POSITIVE:
+        case CLASS_POSITIVE_DISTORTIONS: {
+            sign = '+';
+            u64 mask = k == 32 ? ~0ull : (1ull << (2*k)) - 1;
+            u64 code_space = k == 32 ? ~0ull : mask + 1;
+            // a k short enough for the spectrum to fill the whole space can't
+            // take more errors
+            errors = (u64)errors > code_space - count ? code_space - count : errors;
+            s64 added = 0;
+            s64 attempts = 0;
+            while (added < errors && attempts < 100 * (errors + 1)) {
+                attempts++;
+                u64 code;
+                if (error_class == CLASS_RANDOM_POSITIVE) {
+                    code = next_random(&random_state) & mask;
+                } else {
+                    // one base of a real oligo changed
+                    code = codes[random_below(&random_state, true_count)];
+                    s32 position = (s32)random_below(&random_state, k);
+                    u64 change = 1 + random_below(&random_state, 3);
+                    code ^= change << (2*position);
+                }
+                if (sorted_contains(codes, true_count, code)) continue;
+                codes[true_count + added++] = code;
+                // duplicates among the added ones are dropped at the end
+                if (added == errors) {
+                    s64 unique = sort_unique(codes + true_count, added);
+                    // drop the ones that collided with each other and retry
+                    added = unique;
+                }
+            }
+            count = sort_unique(codes, true_count + added);
+            error_count = count - true_count;
+        } break;
+    }
+
+    //
+    // output
+    //
+
+    make_dir(out_dir);
+    char name[256];
+    stb_snprintf(name, sizeof(name), "%d.%lld%c%lld", id, (long long)n, sign,
+                 (long long)error_count);
+
+    Spectrum spectrum = {};
+    spectrum.onct_length = k;
+    spectrum.stride = binary ? k : k + 1;
+    spectrum.count = (s32)count;
+    spectrum.decoded = (char *)malloc(count * spectrum.stride);
+    spectrum.data = spectrum.decoded;
+    for (s64 i = 0; i < count; i++) {
+        char *oligo = spectrum_oligo(&spectrum, (s32)i);
+        code_oligo(codes[i], k, oligo);
+        if (!binary) oligo[k] = '\n';
+    }
+
+    char path[1024];
+    bool ok;
+    if (binary) {
+        stb_snprintf(path, sizeof(path), "%s/%s.sbh", out_dir, name);
+        ok = write_binary_spectrum(path, &spectrum, (s32)n, class_error_classes[error_class],
+                                   true);
+    } else {
+        stb_snprintf(path, sizeof(path), "%s/%s.txt", out_dir, name);
+        FILE *f = fopen(path, "wb");
+        ok = f && fwrite(spectrum.data, spectrum.stride, count, f) == (size_t)count;
+        ok = f && fclose(f) == 0 && ok;
+        if (!ok) fprintf(stderr, "%s: can't write file\n", path);
+    }
+
+    // the reference in a subdirectory, which the batch driver skips
+    char reference_dir[1024];
+    stb_snprintf(reference_dir, sizeof(reference_dir), "%s/reference", out_dir);
+    make_dir(reference_dir);
+    char reference_out[1024];
+    stb_snprintf(reference_out, sizeof(reference_out), "%s/%s.fa", reference_dir, name);
+    FILE *f = fopen(reference_out, "wb");
+    if (f) {
+        fprintf(f, ">%s %s k=%d seed=%llu\n", name, class_names[error_class], k,
+                (unsigned long long)seed);
+        for (s64 i = 0; i < sequence_length; i += 80) {
+            fwrite(sequence + i, 1, stb_min(80, sequence_length - i), f);
+            fputc('\n', f);
+        }
+        ok = fclose(f) == 0 && ok;
+    } else {
+        fprintf(stderr, "%s: can't write file\n", reference_out);
+        ok = false;
+    }
+
+    if (ok) printf("%s;%lld oligos;%lld errors\n", path, (long long)count, (long long)error_count);
+    free_spectrum(&spectrum);
+    free(codes);
+    free(sequence);
+    return ok ? 0 : 1;
+}
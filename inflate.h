@@ -0,0 +1,373 @@
+// inflate.h - small streaming DEFLATE/gzip decoder
+//
+// Do this:
+//      #define INFLATE_IMPL
+// before you include this file in *one* C or C++ file to create the
+// implementation.
+//
+// The compressed input is given as one buffer (typically a memory mapped
+// file). The decompressed output is handed to a sink callback in pieces of at
+// most 32 KB as soon as they are decoded, so the whole output never has to be
+// in memory at once.
+//
+//      int inflate_gzip(const unsigned char *in, size_t in_size,
+//                       inflate_sink *sink, void *user);
+//          decodes a gzip file, including files made of several concatenated
+//          members (e.g. bgzip). the crc32 and size of every member are
+//          checked. returns 0 on success, a negative value on error
+//
+//      int inflate_raw(const unsigned char *in, size_t in_size, size_t *in_used,
+//                      inflate_sink *sink, void *user);
+//          decodes a raw DEFLATE stream and stores how many input bytes it
+//          used in *in_used
+//
+// The decoder follows the canonical Huffman decoding of zlib's "puff": it is
+// simple rather than fast, decoding one bit at a time.
+
+#ifndef INFLATE_INCLUDED
+#define INFLATE_INCLUDED
+
+#include <stddef.h>
+
+typedef void inflate_sink(void *user, unsigned char *data, size_t size);
+
+int inflate_gzip(const unsigned char *in, size_t in_size,
+                 inflate_sink *sink, void *user);
+int inflate_raw(const unsigned char *in, size_t in_size, size_t *in_used,
+                inflate_sink *sink, void *user);
+
+#endif // INFLATE_INCLUDED
+
+#ifdef INFLATE_IMPL
+#include <stdlib.h>
+#include <string.h>
+
+#define INFLATE__WINDOW 65536 // twice the largest match distance
+#define INFLATE__HALF   32768
+
+typedef struct {
+    const unsigned char *in;
+    size_t in_size;
+    size_t in_pos;
+    unsigned long bitbuf;
+    int bitcnt;
+    int error;
+
+    unsigned char *window; // ring buffer of the output
+    size_t out_total;
+    size_t flushed;
+    unsigned long crc;
+
+    inflate_sink *sink;
+    void *user;
+} inflate__state;
+
+typedef struct {
+    short count[16];  // number of codes of each length
+    short symbol[288]; // symbols ordered by code
+} inflate__huffman;
+
+static unsigned long inflate__crc_table[256];
+
+static void inflate__init_crc(void) {
+    if (inflate__crc_table[1]) return;
+    for (unsigned long n = 0; n < 256; n++) {
+        unsigned long c = n;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+        }
+        inflate__crc_table[n] = c;
+    }
+}
+
+static int inflate__bits(inflate__state *s, int need) {
+    unsigned long val = s->bitbuf;
+    while (s->bitcnt < need) {
+        if (s->in_pos == s->in_size) {
+            s->error = -1; // ran out of input
+            return 0;
+        }
+        val |= (unsigned long)s->in[s->in_pos++] << s->bitcnt;
+        s->bitcnt += 8;
+    }
+    s->bitbuf = val >> need;
+    s->bitcnt -= need;
+    return (int)(val & ((1UL << need) - 1));
+}
+
+// hands everything decoded since the last flush to the sink. flushes happen at
+// every 32 KB boundary, so the range is always contiguous in the window
+static void inflate__flush(inflate__state *s) {
+    size_t size = s->out_total - s->flushed;
+    if (!size) return;
+    unsigned char *data = s->window + (s->flushed & (INFLATE__WINDOW-1));
+    unsigned long crc = s->crc ^ 0xFFFFFFFFUL;
+    for (size_t i = 0; i < size; i++) {
+        crc = inflate__crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    s->crc = crc ^ 0xFFFFFFFFUL;
+    s->sink(s->user, data, size);
+    s->flushed = s->out_total;
+}
+
+static void inflate__put(inflate__state *s, unsigned char c) {
+    s->window[s->out_total & (INFLATE__WINDOW-1)] = c;
+    s->out_total++;
+    if ((s->out_total & (INFLATE__HALF-1)) == 0) inflate__flush(s);
+}
+
+static int inflate__decode(inflate__state *s, const inflate__huffman *h) {
+    int code = 0;  // bits read so far
+    int first = 0; // first code of the current length
+    int index = 0; // index of the first code of the current length in symbol
+    for (int len = 1; len < 16; len++) {
+        code |= inflate__bits(s, 1);
+        if (s->error) return s->error;
+        int count = h->count[len];
+        if (code - count < first) return h->symbol[index + (code - first)];
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -10; // ran out of codes
+}
+
+// returns 0 for a complete code, a negative value for an over-subscribed one
+// and a positive value for an incomplete one
+static int inflate__construct(inflate__huffman *h, const short *length, int n) {
+    for (int len = 0; len < 16; len++) h->count[len] = 0;
+    for (int symbol = 0; symbol < n; symbol++) h->count[length[symbol]]++;
+    if (h->count[0] == n) return 0;
+
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0) return left;
+    }
+
+    short offs[16];
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++) offs[len+1] = offs[len] + h->count[len];
+    for (int symbol = 0; symbol < n; symbol++) {
+        if (length[symbol]) h->symbol[offs[length[symbol]]++] = (short)symbol;
+    }
+    return left;
+}
+
+static int inflate__stored(inflate__state *s) {
+    // stored blocks start at a byte boundary
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+    if (s->in_pos + 4 > s->in_size) return -2;
+    unsigned len = s->in[s->in_pos] | (s->in[s->in_pos+1] << 8);
+    unsigned nlen = s->in[s->in_pos+2] | (s->in[s->in_pos+3] << 8);
+    s->in_pos += 4;
+    if (len != (~nlen & 0xffff)) return -2;
+    if (s->in_pos + len > s->in_size) return -2;
+    for (unsigned i = 0; i < len; i++) inflate__put(s, s->in[s->in_pos++]);
+    return 0;
+}
+
+static int inflate__codes(inflate__state *s, const inflate__huffman *lencode,
+                          const inflate__huffman *distcode) {
+    static const short lbase[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const short lext[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const short dbase[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+        8193, 12289, 16385, 24577};
+    static const short dext[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    int symbol;
+    do {
+        symbol = inflate__decode(s, lencode);
+        if (symbol < 0) return symbol;
+        if (symbol < 256) {
+            inflate__put(s, (unsigned char)symbol);
+        } else if (symbol > 256) {
+            symbol -= 257;
+            if (symbol >= 29) return -10;
+            int len = lbase[symbol] + inflate__bits(s, lext[symbol]);
+            symbol = inflate__decode(s, distcode);
+            if (symbol < 0) return symbol;
+            if (symbol >= 30) return -10;
+            size_t dist = dbase[symbol] + inflate__bits(s, dext[symbol]);
+            if (s->error) return s->error;
+            if (dist > s->out_total) return -11; // distance too far back
+            while (len--) {
+                inflate__put(s, s->window[(s->out_total - dist) & (INFLATE__WINDOW-1)]);
+            }
+        }
+    } while (symbol != 256);
+    return 0;
+}
+
+static int inflate__fixed(inflate__state *s) {
+    static inflate__huffman lencode, distcode;
+    static int built = 0;
+    if (!built) {
+        short lengths[288];
+        int symbol = 0;
+        for (; symbol < 144; symbol++) lengths[symbol] = 8;
+        for (; symbol < 256; symbol++) lengths[symbol] = 9;
+        for (; symbol < 280; symbol++) lengths[symbol] = 7;
+        for (; symbol < 288; symbol++) lengths[symbol] = 8;
+        inflate__construct(&lencode, lengths, 288);
+        for (symbol = 0; symbol < 30; symbol++) lengths[symbol] = 5;
+        inflate__construct(&distcode, lengths, 30);
+        built = 1;
+    }
+    return inflate__codes(s, &lencode, &distcode);
+}
+
+static int inflate__dynamic(inflate__state *s) {
+    static const short order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    short lengths[320];
+    inflate__huffman lencode, distcode;
+
+    int nlen = inflate__bits(s, 5) + 257;
+    int ndist = inflate__bits(s, 5) + 1;
+    int ncode = inflate__bits(s, 4) + 4;
+    if (s->error) return s->error;
+    if (nlen > 286 || ndist > 30) return -3;
+
+    int index;
+    for (index = 0; index < ncode; index++) lengths[order[index]] = (short)inflate__bits(s, 3);
+    for (; index < 19; index++) lengths[order[index]] = 0;
+    if (s->error) return s->error;
+    if (inflate__construct(&lencode, lengths, 19) != 0) return -4;
+
+    index = 0;
+    while (index < nlen + ndist) {
+        int symbol = inflate__decode(s, &lencode);
+        if (symbol < 0) return symbol;
+        if (symbol < 16) {
+            lengths[index++] = (short)symbol;
+        } else {
+            short len = 0;
+            if (symbol == 16) {
+                if (index == 0) return -5; // nothing to repeat
+                len = lengths[index-1];
+                symbol = 3 + inflate__bits(s, 2);
+            } else if (symbol == 17) {
+                symbol = 3 + inflate__bits(s, 3);
+            } else {
+                symbol = 11 + inflate__bits(s, 7);
+            }
+            if (s->error) return s->error;
+            if (index + symbol > nlen + ndist) return -6;
+            while (symbol--) lengths[index++] = len;
+        }
+    }
+    if (lengths[256] == 0) return -9; // no end of block code
+
+    int err = inflate__construct(&lencode, lengths, nlen);
+    if (err && (err < 0 || nlen != lencode.count[0] + lencode.count[1])) return -7;
+    err = inflate__construct(&distcode, lengths + nlen, ndist);
+    if (err && (err < 0 || ndist != distcode.count[0] + distcode.count[1])) return -8;
+
+    return inflate__codes(s, &lencode, &distcode);
+}
+
+static int inflate__blocks(inflate__state *s) {
+    int last, err;
+    do {
+        last = inflate__bits(s, 1);
+        int type = inflate__bits(s, 2);
+        if (s->error) return s->error;
+        switch (type) {
+            case 0:  err = inflate__stored(s); break;
+            case 1:  err = inflate__fixed(s); break;
+            case 2:  err = inflate__dynamic(s); break;
+            default: err = -1; break;
+        }
+        if (err) return err;
+    } while (!last);
+    inflate__flush(s);
+    return 0;
+}
+
+static void inflate__start(inflate__state *s, const unsigned char *in,
+                           size_t in_size, size_t in_pos) {
+    s->in = in;
+    s->in_size = in_size;
+    s->in_pos = in_pos;
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+    s->error = 0;
+    s->out_total = 0;
+    s->flushed = 0;
+    s->crc = 0;
+}
+
+int inflate_raw(const unsigned char *in, size_t in_size, size_t *in_used,
+                inflate_sink *sink, void *user) {
+    inflate__state s;
+    inflate__init_crc();
+    inflate__start(&s, in, in_size, 0);
+    s.sink = sink;
+    s.user = user;
+    s.window = (unsigned char *)malloc(INFLATE__WINDOW);
+    if (!s.window) return -12;
+    int err = inflate__blocks(&s);
+    free(s.window);
+    if (in_used) *in_used = s.in_pos;
+    return err;
+}
+
+int inflate_gzip(const unsigned char *in, size_t in_size,
+                 inflate_sink *sink, void *user) {
+    inflate__state s;
+    inflate__init_crc();
+    s.sink = sink;
+    s.user = user;
+    s.window = (unsigned char *)malloc(INFLATE__WINDOW);
+    if (!s.window) return -12;
+
+    int err = 0;
+    size_t pos = 0;
+    while (!err && pos < in_size) {
+        // member header
+        if (in_size - pos < 18 || in[pos] != 0x1f || in[pos+1] != 0x8b || in[pos+2] != 8) {
+            err = -20;
+            break;
+        }
+        int flags = in[pos+3];
+        pos += 10;
+        if (flags & 4) { // extra field
+            if (pos + 2 > in_size) { err = -20; break; }
+            pos += 2 + (in[pos] | (in[pos+1] << 8));
+        }
+        if (flags & 8)  while (pos < in_size && in[pos++]); // file name
+        if (flags & 16) while (pos < in_size && in[pos++]); // comment
+        if (flags & 2)  pos += 2; // header crc
+        if (pos >= in_size) { err = -20; break; }
+
+        inflate__start(&s, in, in_size, pos);
+        err = inflate__blocks(&s);
+        if (err) break;
+        pos = s.in_pos;
+
+        // member trailer
+        if (pos + 8 > in_size) { err = -21; break; }
+        unsigned long crc = in[pos] | (in[pos+1] << 8) | (in[pos+2] << 16) |
+                            ((unsigned long)in[pos+3] << 24);
+        unsigned long size = in[pos+4] | (in[pos+5] << 8) | (in[pos+6] << 16) |
+                             ((unsigned long)in[pos+7] << 24);
+        if (crc != s.crc || size != (s.out_total & 0xFFFFFFFFUL)) err = -22;
+        pos += 8;
+    }
+    free(s.window);
+    return err;
+}
+
+#endif // INFLATE_IMPL
@@ -1,31 +1,28 @@
-// fast configuration
-#if 0
-#define POPULATION  512
-#define GENERATIONS 8
-#define PARENTS     (POPULATION/16)
-#define BREED
-//#define SPARSE_GRAPH
-#define MUTATIONS 1
-//#define OPTIMIZE_GRAPH
-#endif
-
-// normal configuration
-#if 1
-#define POPULATION  (1024*2)
-#define GENERATIONS (1024*8)
-#define PARENTS     (POPULATION/4)
-#define BREED
-//#define SPARSE_GRAPH
-#define MUTATIONS 8
-#define OPTIMIZE_GRAPH
-#endif
+// command line client of the solver library: solves the instance sets, converts
+// and ingests spectra, and serves solves to other processes
 
-#define PARALLEL
 //#define SINGLE_TEST
 
 #include <stdio.h>
-#include <stdint.h>
 #include <assert.h>
+#include <sys/stat.h>
+#include <math.h>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // platform independent filesystem interface
 #ifdef _MSC_VER
@@ -34,498 +31,1152 @@
 #include <dirent.h>
 #endif
 
-#define STB_DEFINE
-#define STB_NO_REGISTRY
 #include "stb.h"
 
 // platform independent high precision timer
-#define SOKOL_IMPL
 #include "sokol_time.h"
 
-typedef int8_t  s8;
-typedef int16_t s16;
-typedef int32_t s32;
-typedef int64_t s64;
+#include "sbh.h"
 
-typedef uint8_t  u8;
-typedef uint16_t u16;
-typedef uint32_t u32;
-typedef uint64_t u64;
-
-struct Edge {
-    s32 next; // connected node index
-    s32 cost; // how many nonoverlapping oncts are added to the solution
+// one instance file of a batch
+struct Job {
+    char name[256];
+    s32 original_oncts;
+    s64 file_size;
+    u64 seed;
+    double percent_score;
+    double elapsed;
+    size_t memory_size;
+    size_t huge_page_bytes;
+    double phase_ms[PHASE_COUNT];
+    s64 cache_lookups;
+    s64 cache_hits;
+    bool failed;
 };
 
-struct Node {
-    Edge *edges;
-    s32 edge_count;
-};
+int job_size_cmp(const void *a, const void *b) {
+    s64 size_a = ((Job *)a)->file_size;
+    s64 size_b = ((Job *)b)->file_size;
+    return (size_a < size_b) - (size_a > size_b);
+}
 
-s32 get_overlap(char *a, char *b, s32 onct_length) {
-    for (s32 overlap = onct_length-1;
-         overlap > 0;
-         overlap--)
-    {
-        char *x = a + onct_length - overlap;
-        s32 i = 0;
-        while (i < overlap && x[i] == b[i]) {
-            i++;
-        }
-        if (i == overlap) return overlap;
+char *problem_dirs[] = {"Instances/PositiveErrorsWithDistortions",
+                        "Instances/RandomNegativeErrors",
+                        "Instances/RandomPositiveErrors",
+                        "Instances/RepetitionNegativeErrors"};
+
+// the instance files of a directory, largest first
+Job * list_jobs(char *dir_path) {
+    DIR *problem_dir = opendir(dir_path);
+    if (!problem_dir) {
+        fprintf(stderr, "%s: can't open directory\n", dir_path);
+        return 0;
     }
 
-    return 0;
-}
+    Job *job_list = 0;
 
-s32 score_candidate(Edge *candidate, s32 onct_length, s32 max_solution_length, s32 node_count) {
-    s32 oncts_visited = 0;
-    s32 total_length = onct_length;
-    s32 current = candidate[0].next;
-    u8 visited[1024] = {};
-    while (candidate[current].cost) {
-        if (visited[current]) break;
-        visited[current] = true;
-        oncts_visited++;
-        if (candidate[current].cost + total_length > max_solution_length) {
-            return oncts_visited;
-        }
-        total_length += candidate[current].cost;
-        current = candidate[current].next;
-        assert(current >= 0 && current < node_count);
-    }
-    return oncts_visited;
-}
+    struct dirent *dir_entry;
+    while (dir_entry = readdir(problem_dir)) {
+        if (dir_entry->d_type != DT_REG) continue;
 
-void print_path(char **dict, Edge *candidate, s32 max_solution_length) {
-    s32 total_length = strlen(dict[0]);
-    s32 current = candidate[0].next;
-    u8 visited[1024] = {};
-    while (candidate[current].cost) {
-        if (visited[current]) break;
-        visited[current] = true;
+        Job job = {};
+        stb_snprintf(job.name, sizeof(job.name), "%s", dir_entry->d_name);
+        sscanf(dir_entry->d_name, "%*d.%d", &job.original_oncts);
 
-        printf("%s\n", dict[current-1]);
-        if (candidate[current].cost + total_length > max_solution_length) {
-            break;
+        char path[1024] = {};
+        stb_snprintf(path, 1024, "%s/%s", dir_path, job.name);
+        struct stat file_stat;
+        if (stat(path, &file_stat) == 0) {
+            job.file_size = file_stat.st_size;
         }
-        total_length += candidate[current].cost;
-        current = candidate[current].next;
+        job.seed = stb_rand();
+        stb_arr_push(job_list, job);
     }
-    puts("");
-    return;
-}
+    closedir(problem_dir);
 
-void print_solution(char **dict, Edge *candidate, s32 max_solution_length) {
-    s32 onct_length = strlen(dict[0]);
-    s32 total_length = onct_length;
-    s32 current = candidate[0].next;
-    u8 visited[1024] = {};
-    s32 last_cost = onct_length;
-    while (candidate[current].cost) {
-        if (visited[current]) break;
-        visited[current] = true;
-
-        printf("%s", dict[current-1] + (onct_length-last_cost));
-        if (candidate[current].cost + total_length > max_solution_length) {
-            break;
-        }
-        total_length += candidate[current].cost;
-        last_cost = candidate[current].cost;
-        current = candidate[current].next;
-    }
-    puts("");
-    return;
+    // largest instances first, so the small ones fill the gaps at the end
+    qsort(job_list, stb_arr_len(job_list), sizeof(Job), job_size_cmp);
+    return job_list;
 }
 
-s32 optimize_and_score(Edge *candidate, Node *graph, s32 onct_length,
-                       s32 max_solution_length, s32 node_count) {
-    s32 oncts_visited = 0;
-    s32 total_length = onct_length;
-    s32 current = candidate[0].next;
-    u8 visited[1024] = {};
-    while (candidate[current].cost) {
-        visited[current] = true;
-        oncts_visited++;
-        Edge edge = candidate[current];
-        bool too_long = edge.cost + total_length > max_solution_length;
-        bool next_visited = visited[edge.next];
-        if (too_long || next_visited) {
-            // try to find a legal edge
-            s32 i;
-            for (i = 0; i < graph[current].edge_count; i++) {
-                edge = graph[current].edges[i];
-                too_long = edge.cost + total_length > max_solution_length;
-                next_visited = visited[edge.next];
-                if (!too_long && !next_visited) {
-                    candidate[current] = edge;
-                    break;
+// one line per phase, for all threads together and for each thread
+void print_counters(char *name, Solve_Result *result) {
+    for (s32 thread = -1; thread < result->thread_count; thread++) {
+        Phase_Counters *counters = thread < 0 ? &result->counters
+                                              : &result->thread_counters[thread];
+        for (s32 phase = PHASE_LOAD+1; phase < PHASE_COUNT; phase++) {
+            if (thread < 0) printf("counters;%s;all;%s", name, phase_name(phase));
+            else printf("counters;%s;%d;%s", name, thread, phase_name(phase));
+            for (s32 counter = 0; counter < COUNTER_COUNT; counter++) {
+                if (result->counters_available & (1 << counter)) {
+                    printf(";%llu", (unsigned long long)counters->values[phase][counter]);
+                } else {
+                    printf(";");
                 }
             }
-            if (i == graph[current].edge_count) { // legal edge not found
-                break;
-            }
+            printf("\n");
         }
-        total_length += edge.cost;
-        current = edge.next;
-        assert(current >= 0 && current < node_count);
     }
-    // nocheckin
-    if (candidate[current].cost == 0) {
-        puts("exiting because cost is 0!!!!!!!!!!!!!!!");
+}
+
+//
+// regression harness. solves instance sets with fixed seeds several times,
+// saves mean, standard deviation and 95th percentile of score and time per
+// instance as a baseline, and compares later runs against it
+//
+
+#define REGRESS_SIGMAS     3    // differences within this many standard errors are noise
+#define REGRESS_TIME_SLACK 0.10 // and so is less than 10% more time
+#define REGRESS_SCORE_SLACK 0.5 // or less than half a percent point of score
+
+struct Stats {
+    double mean;
+    double stddev;
+    double p95;
+};
+
+Stats compute_stats(double *values, s32 count) {
+    Stats result = {};
+    if (!count) return result;
+    double *sorted = (double *)malloc(count * sizeof(double));
+    memcpy(sorted, values, count * sizeof(double));
+    std::sort(sorted, sorted + count);
+    for (s32 i = 0; i < count; i++) result.mean += sorted[i];
+    result.mean /= count;
+    for (s32 i = 0; i < count; i++) {
+        result.stddev += (sorted[i] - result.mean) * (sorted[i] - result.mean);
     }
-    return oncts_visited;
+    result.stddev = count > 1 ? sqrt(result.stddev / (count - 1)) : 0;
+    // nearest rank
+    s32 rank = (s32)ceil(0.95 * count) - 1;
+    result.p95 = sorted[stb_clamp(rank, 0, count-1)];
+    free(sorted);
+    return result;
 }
 
-void optimize_graph(Node *graph, s32 node_count) {
-    // find optimal edges connecting [i] to [j]
-    s32 optimal_edges[1024][1024] = {};
-    for (s32 node_i = 0; node_i < node_count; node_i++) {
-        Node node = graph[node_i];
-        for (s32 edge_i = 0; edge_i < node.edge_count; edge_i++) {
-            Edge e = node.edges[edge_i];
-            if (e.cost != 1) break;
-            optimal_edges[node_i][e.next] += 1;
-        }
-    }
-    // search for nodes to merge
-    for (s32 node_i = 0; node_i < node_count; node_i++) {
-        s32 row_sum = 0;
-        s32 dest_j = -1;
-        for (s32 j = 0; j < node_count; j++) {
-            row_sum += optimal_edges[node_i][j];
-            if (optimal_edges[node_i][j] > 0) {
-                dest_j = j;
-            }
-            if (row_sum > 1) break;
-        }
-        if (row_sum != 1) continue;
-        s32 col_sum = 0;
-        for (s32 i = 0; i < node_count; i++) {
-            col_sum += optimal_edges[i][dest_j];
-            if (col_sum > 1) break;
-        }
-        if (col_sum != 1) continue;
-        // at this point we know the nodes can be merged
-        // delete all suboptimal edges from source node
-        {
-            Node *node = &graph[node_i];
-            node->edges[0].next = dest_j;
-            node->edges[0].cost = 1;
-            node->edge_count = 1;
-        }
-
-        // delete all suboptimal edges into dest node
-        for (s32 i = 0; i < node_count; i++) {
-            Node *node = &graph[i];
-            if (i == node_i || i == dest_j) continue;
-            for (s32 edge_i = 0; edge_i < node->edge_count; edge_i++) {
-                if (node->edges[edge_i].next != dest_j) continue;
-
-                s32 remaining_edges = node->edge_count - edge_i - 1;
-                memmove(&node->edges[edge_i],
-                        &node->edges[edge_i+1],
-                        remaining_edges * sizeof(Edge));
-                node->edge_count--;
-                break;
-            }
-        }
+struct Baseline_Entry {
+    s32 set;
+    char name[256];
+    s32 repetitions;
+    Stats score;
+    Stats time;
+};
+
+Baseline_Entry * read_baseline(char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "%s: no baseline, create one with -save\n", path);
+        return 0;
+    }
+    Baseline_Entry *entries = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        Baseline_Entry e = {};
+        s32 fields = sscanf(line, "%d;%255[^;];%d;%lf;%lf;%lf;%lf;%lf;%lf",
+                            &e.set, e.name, &e.repetitions,
+                            &e.score.mean, &e.score.stddev, &e.score.p95,
+                            &e.time.mean, &e.time.stddev, &e.time.p95);
+        // the header doesn't parse
+        if (fields == 9) stb_arr_push(entries, e);
     }
+    fclose(f);
+    return entries;
 }
 
-Edge * solve(char **dict, s32 dict_size, s32 original_oncts, double *percent_score) {
-    s32 onct_length = strlen(dict[0]);
-    s32 max_solution_length = original_oncts + onct_length - 1;
-
-    //
-    // build the graph
-    //
-
-    s32 node_count = dict_size + 1;
-
-    // edges are allocated after the nodes
-    s32 nodes_mem_size = sizeof(Node) * node_count;
-    s32 edges_mem_size = sizeof(Edge) * node_count * (node_count - 1);
-
-    Node *graph = (Node *)malloc(nodes_mem_size + edges_mem_size);
-    Edge *edges = (Edge *)(graph + node_count);
-
-    // add a synthetic node with 0 cost connections to all other nodes
-    graph[0].edges = edges;
-    graph[0].edge_count = 0;
-    for (s32 dest_i = 1; dest_i < node_count; dest_i++) {
-        Edge e = {};
-        e.next = dest_i;
-        graph[0].edges[graph[0].edge_count++] = e;
-    }
-    s32 total_edges = graph[0].edge_count;
-
-    for (s32 node_i = 1; node_i < node_count; node_i++) {
-        Node *node = &graph[node_i];
-        node->edges = edges + total_edges;
-        node->edge_count = 0;
-        for (s32 dest_i = 1; dest_i < node_count; dest_i++) {
-            if (node_i == dest_i) continue;
-            s32 overlap = get_overlap(dict[node_i-1], dict[dest_i-1], onct_length);
-#ifdef SPARSE_GRAPH
-            if (overlap > 0)
-#endif
-            {
-                Edge e;
-                e.next = dest_i;
-                e.cost = onct_length - overlap;
-                node->edges[node->edge_count++] = e;
-            }
+bool write_baseline(char *path, Baseline_Entry *entries) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "%s: can't write baseline\n", path);
+        return false;
+    }
+    fprintf(f, "set;name;repetitions;score_mean;score_stddev;score_p95;"
+               "time_mean;time_stddev;time_p95\n");
+    for (s32 i = 0; i < stb_arr_len(entries); i++) {
+        Baseline_Entry *e = &entries[i];
+        fprintf(f, "%d;%s;%d;%f;%f;%f;%f;%f;%f\n", e->set, e->name, e->repetitions,
+                e->score.mean, e->score.stddev, e->score.p95,
+                e->time.mean, e->time.stddev, e->time.p95);
+    }
+    fclose(f);
+    return true;
+}
+
+// standard error of the difference of two means
+double difference_error(Stats *a, s32 count_a, Stats *b, s32 count_b) {
+    return sqrt(a->stddev * a->stddev / stb_max(count_a, 1) +
+                b->stddev * b->stddev / stb_max(count_b, 1));
+}
+
+// seq -regress sets [-repetitions R] [-seed S] [-baseline path] [-save]
+// sets are the digits of the instance sets to run, for example 13. returns 1
+// when an instance got slower or worse, or the whole run got slower
+int regress(int argc, char **argv) {
+    char *sets = argv[2];
+    s32 repetitions = 5;
+    u64 base_seed = 1;
+    char *baseline_path = "results/baseline.csv";
+    bool save = false;
+    for (s32 arg_i = 3; arg_i < argc; arg_i++) {
+        if (!strcmp(argv[arg_i], "-repetitions") && arg_i+1 < argc) {
+            repetitions = atoi(argv[++arg_i]);
+        } else if (!strcmp(argv[arg_i], "-seed") && arg_i+1 < argc) {
+            base_seed = strtoull(argv[++arg_i], 0, 10);
+        } else if (!strcmp(argv[arg_i], "-baseline") && arg_i+1 < argc) {
+            baseline_path = argv[++arg_i];
+        } else if (!strcmp(argv[arg_i], "-save")) {
+            save = true;
         }
+    }
+    if (repetitions < 1) repetitions = 1;
 
-        // sort edges in the node by cost
-        qsort(node->edges, node->edge_count,
-              sizeof(Edge), stb_intcmp(offsetof(Edge, cost)));
-        total_edges += graph[node_i].edge_count;
+    Baseline_Entry *baseline = 0;
+    if (!save) {
+        baseline = read_baseline(baseline_path);
+        if (!baseline) return 1;
     }
 
-#ifdef OPTIMIZE_GRAPH
-    // pass graph without first synthetic node
-    optimize_graph(graph+1, node_count-1);
-#endif
+    Solver_Context *context = create_solver_context();
+    double *scores = (double *)malloc(repetitions * sizeof(double));
+    double *times = (double *)malloc(repetitions * sizeof(double));
+    Baseline_Entry *entries = 0;
+    s32 regressions = 0;
+    double total_time = 0;
+    double total_baseline_time = 0;
+    Stats total_stats = {};
+    Stats total_baseline_stats = {};
 
-    //
-    // create population
-    //
+    printf("set;name;score;baseline score;time;baseline time;verdict\n");
+    for (char *set_char = sets; *set_char; set_char++) {
+        s32 set = *set_char - '0';
+        if (set < 0 || set > 3) continue;
+        Job *job_list = list_jobs(problem_dirs[set]);
+        for (s32 job_i = 0; job_i < stb_arr_len(job_list); job_i++) {
+            Job *job = &job_list[job_i];
+            char path[1024] = {};
+            stb_snprintf(path, 1024, "%s/%s", problem_dirs[set], job->name);
+            Spectrum spectrum;
+            if (!load_spectrum(path, &spectrum)) {
+                regressions++;
+                continue;
+            }
+            if (spectrum.original_length) job->original_oncts = spectrum.original_length;
 
-    s32 population = POPULATION;
-    s32 parent_count = PARENTS;
-    s32 candidate_size = node_count * sizeof(Edge);
-    u8 *candidates = (u8 *)calloc(population + parent_count, candidate_size);
-    u8 *parents = candidates + population * candidate_size;
+            bool solved = true;
+            for (s32 rep = 0; rep < repetitions && solved; rep++) {
+                // the same seeds every time, so only the code changes the result
+                u64 seed = base_seed * 1000003 + stb_hash(job->name) * 31 + rep;
+                Solve_Params params = default_params(seed);
+                Solve_Result result;
+                solved = solve(context, &spectrum, job->original_oncts, &params, &result);
+                scores[rep] = result.percent_score;
+                times[rep] = result.elapsed_ms;
+            }
+            free_spectrum(&spectrum);
+            if (!solved) {
+                fprintf(stderr, "%s: not solved\n", path);
+                regressions++;
+                continue;
+            }
 
-    struct Score {s32 oncts; s32 index;};
-    Score *scores = (Score *)malloc(sizeof(Score) * population);
+            Baseline_Entry entry = {};
+            entry.set = set;
+            stb_snprintf(entry.name, sizeof(entry.name), "%s", job->name);
+            entry.repetitions = repetitions;
+            entry.score = compute_stats(scores, repetitions);
+            entry.time = compute_stats(times, repetitions);
+            stb_arr_push(entries, entry);
+            if (save) {
+                printf("%d;%s;%f%%;;%fms;;saved\n", set, entry.name,
+                       entry.score.mean, entry.time.mean);
+                continue;
+            }
 
-    for (s32 candidate_index = 0;
-         candidate_index < population;
-         candidate_index++)
-    {
-        Edge *candidate = (Edge *)(candidates + candidate_index*candidate_size);
-        for (s32 i = 0; i < node_count; i++) {
-            s32 edge_count = graph[i].edge_count;
-            if (edge_count) {
-                //s32 chosen_edge = stb_rand() % stb_min(2, edge_count);
-                s32 chosen_edge = 0;
-                if (i == 0) {
-                    chosen_edge = candidate_index % edge_count;
+            Baseline_Entry *base = 0;
+            for (s32 i = 0; i < stb_arr_len(baseline); i++) {
+                if (baseline[i].set == set && !strcmp(baseline[i].name, entry.name)) {
+                    base = &baseline[i];
                 }
-                candidate[i] = graph[i].edges[chosen_edge];
             }
+            if (!base) {
+                printf("%d;%s;%f%%;;%fms;;new\n", set, entry.name,
+                       entry.score.mean, entry.time.mean);
+                continue;
+            }
+
+            double time_error = difference_error(&entry.time, repetitions,
+                                                 &base->time, base->repetitions);
+            double score_error = difference_error(&entry.score, repetitions,
+                                                  &base->score, base->repetitions);
+            bool slower = entry.time.mean - base->time.mean >
+                          stb_max(REGRESS_SIGMAS * time_error,
+                                  REGRESS_TIME_SLACK * base->time.mean);
+            bool worse = base->score.mean - entry.score.mean >
+                         stb_max(REGRESS_SIGMAS * score_error, REGRESS_SCORE_SLACK);
+            const char *verdict = slower && worse ? "slower,worse" :
+                            slower ? "slower" : worse ? "worse" : "ok";
+            if (slower || worse) regressions++;
+            printf("%d;%s;%f%%;%f%%;%fms;%fms;%s\n", set, entry.name,
+                   entry.score.mean, base->score.mean,
+                   entry.time.mean, base->time.mean, verdict);
+
+            // for the throughput of the whole run. variances add up
+            total_time += entry.time.mean;
+            total_baseline_time += base->time.mean;
+            total_stats.stddev += entry.time.stddev * entry.time.stddev;
+            total_baseline_stats.stddev += base->time.stddev * base->time.stddev;
         }
-        Score s;
-        s.oncts = optimize_and_score(candidate, graph, onct_length,
-                                     max_solution_length, node_count);
-        s.index = candidate_index;
-        scores[candidate_index] = s;
+        stb_arr_free(job_list);
+    }
+
+    int exit_code = 0;
+    if (save) {
+        if (!write_baseline(baseline_path, entries)) exit_code = 1;
+    } else if (total_baseline_time > 0) {
+        total_stats.stddev = sqrt(total_stats.stddev);
+        total_baseline_stats.stddev = sqrt(total_baseline_stats.stddev);
+        double error = difference_error(&total_stats, repetitions,
+                                        &total_baseline_stats, repetitions);
+        bool slower = total_time - total_baseline_time >
+                      stb_max(REGRESS_SIGMAS * error, REGRESS_TIME_SLACK * total_baseline_time);
+        printf("total;;;;%fms;%fms;%s\n", total_time, total_baseline_time,
+               slower ? "slower" : "ok");
+        if (slower) regressions++;
+        exit_code = regressions ? 1 : 0;
+    }
+    if (regressions) printf("%d regressions\n", regressions);
+
+    stb_arr_free(entries);
+    stb_arr_free(baseline);
+    free(times);
+    free(scores);
+    free_solver_context(context);
+    return exit_code;
+}
+
+//
+// solver daemon
+//
+// seq -serve [-socket path] [-jobs N]
+//
+// keeps N workers, each with a solver context and OpenMP team that stay warm
+// between requests, and hands them requests in order of arrival. without
+// -socket requests come from stdin and answers go to stdout, and the server
+// exits once the input ends and everything is answered. with -socket every
+// client connection is such a stream. a request is one line:
+//
+//      solve ID ORIGINAL_ONCTS PATH
+//      spectrum ID ORIGINAL_ONCTS SIZE   followed by SIZE bytes of a binary spectrum, at most 64 MB
+//      stats ID
+//
+// IDs have no spaces or semicolons. with ORIGINAL_ONCTS 0 the length comes from
+// the binary spectrum or from an I.N-E file name. every request gets one line
+// back, in the order they finish, with the time it waited in the queue, the
+// time of the solve and the total since it was read:
+//
+//      ID;ok;SCORE%;QUEUE_MS;SOLVE_MS;TOTAL_MS;SEQUENCE
+//      ID;error;MESSAGE
+//      ID;stats;SOLVED;MEAN_MS;P50_MS;P99_MS;MAX_MS   total times of all solves so far
+
+#ifndef _WIN32
+
+// a client stream. requests keep it open until they are answered
+struct Connection {
+    int out;
+    std::mutex write_lock;
+    std::atomic<s32> refs; // the reader and every unanswered request
+};
+
+void release_connection(Connection *connection) {
+    if (--connection->refs == 0) {
+        if (connection->out != STDOUT_FILENO) close(connection->out);
+        delete connection;
+    }
+}
+
+void send_line(Connection *connection, char *line, size_t length) {
+    std::lock_guard<std::mutex> guard(connection->write_lock);
+    while (length > 0) {
+        ssize_t written = write(connection->out, line, length);
+        if (written <= 0) break; // the client went away
+        line += written;
+        length -= written;
     }
+}
 
-    //
-    // evolve
-    //
+// bigger inline spectra are refused. the largest solvable spectrum is far smaller
+#define MAX_PAYLOAD_SIZE (64 << 20)
+
+struct Request {
+    Request *next;
+    Connection *connection;
+    char id[64];
+    s32 original_oncts;
+    char path[1024];
+    u8 *payload; // an inline binary spectrum, 0 for path
+    size_t payload_size;
+    u64 received;
+};
 
-    s32 optimal_score = stb_min(dict_size, original_oncts);
+struct Server {
+    std::mutex lock;
+    std::condition_variable ready;
+    Request *first; // queue in order of arrival
+    Request *last;
+    bool closing;   // no more requests will come
+    double *total_ms; // stb_arr of every answered solve
+    s32 threads;    // team size inside each solve
+};
+
+void send_error(Connection *connection, char *id, char *message) {
+    char line[1200];
+    stb_snprintf(line, sizeof(line), "%s;error;%s\n", id, message);
+    send_line(connection, line, strlen(line));
+}
 
-#ifdef OPTIMIZE_GRAPH
-    s32 to_mutate[1024];
-    s32 to_mutate_count = 0;
-    for (s32 node_i = 0; node_i < node_count; node_i++) {
-        if (graph[node_i].edge_count > 1) {
-            to_mutate[to_mutate_count++] = node_i;
+void send_stats(Server *server, Connection *connection, char *id) {
+    double *sorted = 0;
+    {
+        std::lock_guard<std::mutex> guard(server->lock);
+        for (s32 i = 0; i < stb_arr_len(server->total_ms); i++) {
+            stb_arr_push(sorted, server->total_ms[i]);
         }
     }
-    //printf("%d to mutate\n", to_mutate_count);
-#endif
+    s32 count = stb_arr_len(sorted);
+    std::sort(sorted, sorted + count);
+    double sum = 0;
+    for (s32 i = 0; i < count; i++) sum += sorted[i];
+    // nearest rank
+    auto percentile = [&](double p) {
+        return count ? sorted[stb_clamp((s32)ceil(p * count) - 1, 0, count-1)] : 0.0;
+    };
+    char line[256];
+    stb_snprintf(line, sizeof(line), "%s;stats;%d;%f;%f;%f;%f\n", id, count,
+                 count ? sum / count : 0.0, percentile(0.5), percentile(0.99), percentile(1));
+    send_line(connection, line, strlen(line));
+    stb_arr_free(sorted);
+}
 
-    s32 generations = GENERATIONS;
-    for (s32 gen_index = 0; gen_index < generations; gen_index++)
+void enqueue_request(Server *server, Request *request) {
+    request->connection->refs++;
     {
-        qsort(scores, population, sizeof(Score), stb_intcmprev(0));
+        std::lock_guard<std::mutex> guard(server->lock);
+        if (server->last) server->last->next = request;
+        else server->first = request;
+        server->last = request;
+    }
+    server->ready.notify_one();
+}
 
-        if (scores[0].oncts == optimal_score) break;
+// parses the requests of one stream until it ends
+void read_requests(Server *server, Connection *connection, FILE *in) {
+    char line[1200];
+    while (fgets(line, sizeof(line), in)) {
+        char command[32] = {};
+        char id[64] = "?";
+        s32 original_oncts = 0;
+        char argument[1024] = {};
+        s32 fields = sscanf(line, "%31s %63s %d %1023[^\r\n]", command, id, &original_oncts,
+                            argument);
+        if (fields <= 0) continue;
+        if (!strcmp(command, "stats") && fields >= 2) {
+            send_stats(server, connection, id);
+            continue;
+        }
+        bool inline_spectrum = !strcmp(command, "spectrum");
+        if (fields != 4 || (!inline_spectrum && strcmp(command, "solve"))) {
+            send_error(connection, id, "malformed request");
+            continue;
+        }
 
-#ifdef PARALLEL
-#pragma omp parallel
-#endif
-        {
-            // save the best solutions for breeding
-#ifdef PARALLEL
-#pragma omp for
-#endif
-            for (s32 parent_i = 0; parent_i < parent_count; parent_i++) {
-                Edge *parent_slot = (Edge *)(parents + parent_i*candidate_size);
-                s32 old_index = scores[parent_i].index;
-                scores[parent_i].index = parent_i;
-                Edge *parent = (Edge *)(candidates + old_index*candidate_size);
-                memcpy(parent_slot, parent, candidate_size);
+        Request *request = (Request *)calloc(1, sizeof(Request));
+        request->connection = connection;
+        stb_snprintf(request->id, sizeof(request->id), "%s", id);
+        request->original_oncts = original_oncts;
+        if (inline_spectrum) {
+            request->payload_size = strtoull(argument, 0, 10);
+            if (request->payload_size > MAX_PAYLOAD_SIZE) {
+                // the payload can't be skipped safely, so the stream ends here
+                send_error(connection, id, "spectrum too big");
+                free(request);
+                break;
             }
-            // move them to the beggining of the population
-#ifdef PARALLEL
-#pragma omp single
-#endif
-            memcpy(candidates, parents, parent_count * candidate_size);
+            request->payload = (u8 *)malloc(request->payload_size ? request->payload_size : 1);
+            if (!request->payload) {
+                send_error(connection, id, "out of memory");
+                free(request);
+                break;
+            }
+            if (fread(request->payload, 1, request->payload_size, in) != request->payload_size) {
+                send_error(connection, id, "spectrum cut short");
+                free(request->payload);
+                free(request);
+                break;
+            }
+        } else {
+            stb_snprintf(request->path, sizeof(request->path), "%s", argument);
+        }
+        request->received = stm_now();
+        enqueue_request(server, request);
+    }
+}
 
-            // set the rest of the population to modified versions of parents
-#ifdef PARALLEL
-#pragma omp for
-#endif
-            for (s32 candidate_index = parent_count;
-                    candidate_index < population;
-                    candidate_index++)
-            {
-#ifdef BREED
-                s32 parent_a_i = candidate_index % parent_count;
-                s32 parent_b_i = stb_rand() % parent_count;
-                s32 split = stb_rand() % node_count;
-                //s32 split = node_count/2;
-                s32 size_a = split * sizeof(Edge);
-                //s32 size_a = (node_count/2) * sizeof(Edge);
-                s32 size_b = candidate_size - size_a;
-                Edge *parent_a = (Edge *)(candidates + parent_a_i*candidate_size);
-                Edge *parent_b = (Edge *)(candidates + parent_b_i*candidate_size + size_a);
-                Edge *candidate   = (Edge *)(candidates + candidate_index*candidate_size);
-                Edge *candidate_b = (Edge *)(candidates + candidate_index*candidate_size + size_a);
-                // move the first half of the genes from the first parent
-                memcpy(candidate, parent_a, size_a);
-                // move the second half of the genes from the second parent
-                memcpy(candidate_b, parent_b, size_b);
-#else
-                Edge *candidate = (Edge *)(candidates + candidate_index*candidate_size);
-                s32 parent_i = candidate_index % parent_count;
-                Edge *parent = (Edge *)(candidates + parent_i*candidate_size);
-                memcpy(candidate, parent, candidate_size);
-#endif
-                //
-                // mutate
-                //
+void solve_request(Server *server, Solver_Context *context, Request *request) {
+    u64 dequeued = stm_now();
+    Connection *connection = request->connection;
+    Spectrum spectrum;
+    bool loaded = request->payload
+                ? read_binary_spectrum(request->id, request->payload, request->payload_size,
+                                       &spectrum)
+                : load_spectrum(request->path, &spectrum);
+    if (!loaded) {
+        send_error(connection, request->id, "can't load the spectrum");
+        return;
+    }
 
-                for (s32 i = 0; i < MUTATIONS; i++) {
-#ifndef OPTIMIZE_GRAPH
-                    s32 node_to_mutate = stb_rand() % node_count;
-#else
-                    s32 node_to_mutate = to_mutate[stb_rand() % to_mutate_count];
-#endif
-                    Node node = graph[node_to_mutate];
-                    double rand_v = stb_frand();
-                    s32 new_edge = (s32)(rand_v * rand_v * node.edge_count);
-                    candidate[node_to_mutate] = node.edges[new_edge];
-                }
+    s32 original_oncts = request->original_oncts;
+    if (!original_oncts) original_oncts = spectrum.original_length;
+    if (!original_oncts && !request->payload) {
+        char *name = strrchr(request->path, '/');
+        sscanf(name ? name+1 : request->path, "%*d.%d", &original_oncts);
+    }
+    if (original_oncts <= 0) {
+        send_error(connection, request->id, "unknown original length");
+        free_spectrum(&spectrum);
+        return;
+    }
 
-                s32 score = optimize_and_score(candidate, graph, onct_length,
-                        max_solution_length, node_count);
-                scores[candidate_index].oncts = score;
-                scores[candidate_index].index = candidate_index;
-            }
+    // every request gets a seed of its own, stb_rand isn't thread safe
+    Solve_Params params = default_params(request->received ^ (u64)(size_t)request);
+    params.threads = server->threads;
+    Solve_Result result;
+    if (!solve(context, &spectrum, original_oncts, &params, &result)) {
+        send_error(connection, request->id, "solve failed");
+        free_spectrum(&spectrum);
+        return;
+    }
+    free_spectrum(&spectrum);
+
+    double total_ms = stm_ms(stm_since(request->received));
+    {
+        std::lock_guard<std::mutex> guard(server->lock);
+        stb_arr_push(server->total_ms, total_ms);
+    }
+    size_t capacity = result.sequence_length + 256;
+    char *line = (char *)malloc(capacity);
+    stb_snprintf(line, (int)capacity, "%s;ok;%f%%;%f;%f;%f;%s\n", request->id,
+                 result.percent_score, stm_ms(stm_diff(dequeued, request->received)),
+                 result.elapsed_ms, total_ms, result.sequence);
+    send_line(connection, line, strlen(line));
+    free(line);
+}
+
+void serve_worker(Server *server) {
+    Solver_Context *context = create_solver_context();
+    for (;;) {
+        Request *request;
+        {
+            std::unique_lock<std::mutex> guard(server->lock);
+            server->ready.wait(guard, [&] { return server->first || server->closing; });
+            request = server->first;
+            if (!request) break;
+            server->first = request->next;
+            if (!server->first) server->last = 0;
         }
+        solve_request(server, context, request);
+        release_connection(request->connection);
+        free(request->payload);
+        free(request);
     }
+    free_solver_context(context);
+}
 
-    s32 best_i = 0;
-    for (s32 i = 1; i < population; i++) {
-        if (scores[i].oncts > scores[best_i].oncts) {
-            best_i = i;
+int serve(int argc, char **argv) {
+    char *socket_path = 0;
+    s32 jobs = 1;
+    for (s32 arg_i = 2; arg_i < argc; arg_i++) {
+        if (!strcmp(argv[arg_i], "-socket") && arg_i+1 < argc) {
+            socket_path = argv[++arg_i];
+        } else if (!strcmp(argv[arg_i], "-jobs") && arg_i+1 < argc) {
+            jobs = atoi(argv[++arg_i]);
         }
     }
-    //qsort(scores, population, sizeof(Score), stb_intcmprev(0));
-    s32 best_score = scores[best_i].oncts;
-    s32 best_index = scores[best_i].index;
-    *percent_score = 100*(double)best_score / (double)optimal_score;
+    jobs = stb_max(1, jobs);
 
-    Edge *best_candidate = (Edge *)malloc(candidate_size);
-    memcpy(best_candidate,
-           candidates + best_index*candidate_size,
-           candidate_size);
-    free(graph);
-    free(candidates);
-    free(scores);
-    return best_candidate;
+    Server server = {};
+    server.threads = stb_max(1, core_count() / jobs);
+    std::thread *workers = new std::thread[jobs];
+    for (s32 i = 0; i < jobs; i++) workers[i] = std::thread(serve_worker, &server);
+
+    if (!socket_path) {
+        Connection *connection = new Connection;
+        connection->out = STDOUT_FILENO;
+        connection->refs = 1;
+        read_requests(&server, connection, stdin);
+        release_connection(connection);
+        {
+            std::lock_guard<std::mutex> guard(server.lock);
+            server.closing = true;
+        }
+        server.ready.notify_all();
+        for (s32 i = 0; i < jobs; i++) workers[i].join();
+        delete[] workers;
+        stb_arr_free(server.total_ms);
+        return 0;
+    }
+
+    // answers to a client that went away must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    stb_snprintf(address.sun_path, sizeof(address.sun_path), "%s", socket_path);
+    unlink(socket_path);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener, 64) != 0) {
+        fprintf(stderr, "%s: can't listen on socket\n", socket_path);
+        if (listener >= 0) close(listener);
+        unlink(socket_path);
+        return 1;
+    }
+    fprintf(stderr, "serving on %s with %d workers of %d threads\n", socket_path, jobs,
+            server.threads);
+    for (;;) {
+        int client = accept(listener, 0, 0);
+        if (client < 0) continue;
+        Connection *connection = new Connection;
+        connection->out = client;
+        connection->refs = 1;
+        FILE *in = fdopen(dup(client), "rb");
+        std::thread([&server, connection, in] {
+            read_requests(&server, connection, in);
+            fclose(in);
+            release_connection(connection);
+        }).detach();
+    }
+}
+
+#else
+
+int serve(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    fprintf(stderr, "-serve needs UNIX domain sockets and isn't supported on windows\n");
+    return 1;
+}
+
+#endif
+
+//
+// batch pipeline
+//
+// with -pipeline the batch runs in three stages joined by bounded queues: a
+// loader thread maps and decodes the next spectra, a builder thread builds
+// their graphs (begin_solve), and the jobs workers run the GA (end_solve) on
+// graphs that are ready. loading and building then overlap with the GA of
+// other files instead of leaving the team idle. a stage that gets ahead waits
+// for room in the queue after it, and every file in flight holds a solver
+// context, so memory stays bounded
+//
+
+#define PIPELINE_DEPTH 2 // files waiting between two stages
+
+// a file on its way through the batch. the spectrum and the paths the params
+// point to have to stay until the solve ends
+struct Batch_Item {
+    Job *job;
+    Solver_Context *context;
+    Spectrum spectrum;
+    double load_ms;
+    Solve_Params params;
+    char path[1024];
+    char trace_path[1024];
+    char timeline_path[1024];
+    char checkpoint_path[1024];
+};
+
+struct Pipe {
+    std::mutex lock;
+    std::condition_variable changed;
+    Batch_Item **items; // ring of capacity
+    s32 capacity;
+    s32 first;
+    s32 count;
+    bool closed; // nothing more will be pushed
+};
+
+void pipe_init(Pipe *pipe, s32 capacity) {
+    pipe->items = (Batch_Item **)malloc(capacity * sizeof(Batch_Item *));
+    pipe->capacity = capacity;
+    pipe->first = 0;
+    pipe->count = 0;
+    pipe->closed = false;
+}
+
+// waits while the pipe is full
+void pipe_push(Pipe *pipe, Batch_Item *item) {
+    std::unique_lock<std::mutex> guard(pipe->lock);
+    pipe->changed.wait(guard, [&] { return pipe->count < pipe->capacity; });
+    pipe->items[(pipe->first + pipe->count++) % pipe->capacity] = item;
+    pipe->changed.notify_all();
+}
+
+// waits while the pipe is empty, 0 once it is closed and empty
+Batch_Item * pipe_pop(Pipe *pipe) {
+    std::unique_lock<std::mutex> guard(pipe->lock);
+    pipe->changed.wait(guard, [&] { return pipe->count > 0 || pipe->closed; });
+    if (!pipe->count) return 0;
+    Batch_Item *item = pipe->items[pipe->first];
+    pipe->first = (pipe->first + 1) % pipe->capacity;
+    pipe->count--;
+    pipe->changed.notify_all();
+    return item;
+}
+
+void pipe_close(Pipe *pipe) {
+    std::lock_guard<std::mutex> guard(pipe->lock);
+    pipe->closed = true;
+    pipe->changed.notify_all();
+}
+
+void pipe_free(Pipe *pipe) {
+    free(pipe->items);
 }
 
 int main(int argc, char **argv) {
     stb_srand(time(0));
     stm_setup();
+#ifdef _OPENMP
+    // batch workers and server workers, the runs of a portfolio and the team
+    // of each run, see solve_portfolio
+    omp_set_max_active_levels(3);
+#endif
 
 #ifdef SINGLE_TEST
     //char *path = "test.txt";
     //char *path = "Instances/RandomNegativeErrors/9.200-40.txt";
     char *path = "Instances/RandomNegativeErrors/10.500-200.txt";
     s32 original_oncts = 500;
-    char **dict;
-    s32 dict_size;
-    dict = stb_stringfile(path, &dict_size);
-
-    double percent_score = 0;
-    u64 start_time = stm_now();
-    Edge *best = solve(dict, dict_size, original_oncts, &percent_score);
-    (void)best;
-    double elapsed = stm_ms(stm_since(start_time));
-    printf("result\t%f%%\t%fms\n", percent_score, elapsed);
-    //print_path(dict, best, 209);
-    //print_solution(dict, best, 209);
+    Spectrum spectrum;
+    if (!load_spectrum(path, &spectrum)) return 1;
+
+    Solver_Context *context = create_solver_context();
+    Solve_Params params = default_params(stb_rand());
+    Solve_Result result;
+    if (!solve(context, &spectrum, original_oncts, &params, &result)) return 1;
+    printf("result\t%f%%\t%fms\n", result.percent_score, result.elapsed_ms);
+    //puts(result.sequence);
 
     return 0;
 #endif
 
-    assert(argc > 1);
-    char *problem_dirs[] = {"Instances/PositiveErrorsWithDistortions",
-                            "Instances/RandomNegativeErrors",
-                            "Instances/RandomPositiveErrors",
-                            "Instances/RepetitionNegativeErrors"};
-    char *problem_dir_path = problem_dirs[atoi(argv[1])];
-    DIR *problem_dir = opendir(problem_dir_path);
+    // seq -convert in.txt out.sbh [-sorted]
+    if (argc > 3 && !strcmp(argv[1], "-convert")) {
+        char *in_path = argv[2];
+        char *out_path = argv[3];
+        bool sorted = argc > 4 && !strcmp(argv[4], "-sorted");
 
-    double *scores = 0;
-    double *times = 0;
+        Spectrum spectrum;
+        if (!load_spectrum(in_path, &spectrum)) return 1;
 
-    struct dirent *dir_entry;
-    while (dir_entry = readdir(problem_dir)) {
-        if (dir_entry->d_type != DT_REG) continue;
-
-        s32 original_oncts = 0;
-        sscanf(dir_entry->d_name, "%*d.%d", &original_oncts);
+        // the instance name and directory tell the original length and
+        // the kind of errors
+        char *name = stb_strrchr2(in_path, '/', '\\');
+        name = name ? name+1 : in_path;
+        s32 original_length = spectrum.original_length;
+        if (!original_length) sscanf(name, "%*d.%d", &original_length);
+        u32 error_class = spectrum.error_class;
+        for (s32 i = 0; i < 4 && !error_class; i++) {
+            if (strstr(in_path, problem_dirs[i] + strlen("Instances/"))) {
+                error_class = ERRORS_POSITIVE_WITH_DISTORTIONS + i;
+            }
+        }
 
-        char path[1024] = {};
-        stb_snprintf(path, 1024, "%s/%s", problem_dir_path, dir_entry->d_name);
+        bool ok = write_binary_spectrum(out_path, &spectrum, original_length,
+                                        error_class, sorted);
+        free_spectrum(&spectrum);
+        return ok ? 0 : 1;
+    }
 
-        char **dict;
-        s32 dict_size;
-        dict = stb_stringfile(path, &dict_size);
-        s32 onct_length = strlen(dict[0]);
-        s32 max_solution_length = original_oncts + onct_length - 1;
-        (void)max_solution_length;
-        double percent_score = 0;
+    // seq -ingest reads.fq[.gz] -k K [-length N] [-canonical]
+    // canonical k-mers are solved double stranded
+    if (argc > 2 && !strcmp(argv[1], "-ingest")) {
+        char *in_path = argv[2];
+        s32 onct_length = 10;
+        s32 original_oncts = 0;
+        bool canonical = false;
+        for (s32 arg_i = 3; arg_i < argc; arg_i++) {
+            if (!strcmp(argv[arg_i], "-k") && arg_i+1 < argc) {
+                onct_length = atoi(argv[++arg_i]);
+            } else if (!strcmp(argv[arg_i], "-length") && arg_i+1 < argc) {
+                original_oncts = atoi(argv[++arg_i]);
+            } else if (!strcmp(argv[arg_i], "-canonical")) {
+                canonical = true;
+            }
+        }
 
         u64 start_time = stm_now();
-        Edge *best = solve(dict, dict_size, original_oncts, &percent_score);
-        (void)best;
+        Spectrum spectrum;
+        s32 single_record_oncts = 0;
+        if (!ingest_file(in_path, onct_length, canonical,
+                         &spectrum, &single_record_oncts)) return 1;
+        if (!original_oncts) original_oncts = single_record_oncts;
+        if (!original_oncts) {
+            fprintf(stderr, "%s: several records, give the length with -length\n", in_path);
+            return 1;
+        }
+
+        Solver_Context *context = create_solver_context();
+        Solve_Params params = default_params(stb_rand());
+        params.double_stranded = canonical;
+        Solve_Result result;
+        if (!solve(context, &spectrum, original_oncts, &params, &result)) return 1;
         double elapsed = stm_ms(stm_since(start_time));
-        stb_arr_push(scores, percent_score);
-        stb_arr_push(times, elapsed);
-        printf("%s;%f%%;%fms\n", dir_entry->d_name, percent_score, elapsed);
-        //printf("%s;%f%%;", dir_entry->d_name, percent_score);
-        //print_solution(dict, best, max_solution_length);
-        //s32 result = score_candidate(best, onct_length, max_solution_length, dict_size);
+        printf("%s;%f%%;%fms\n", in_path, result.percent_score, elapsed);
+        puts(result.sequence);
+        free_solver_context(context);
+        free_spectrum(&spectrum);
+        return 0;
+    }
+
+    if (argc > 2 && !strcmp(argv[1], "-regress")) {
+        return regress(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "-serve")) {
+        return serve(argc, argv);
+    }
+
+    assert(argc > 1);
+    s32 portfolio_runs = 0;
+    s32 jobs = 1;
+    u32 context_flags = 0;
+    bool print_phases = false;
+    bool double_stranded = false;
+    bool steady_state = false;
+    bool tasks = false;
+    bool pipeline = false;
+    char *trace_dir = 0;
+    char *timeline_dir = 0;
+    char *checkpoint_dir = 0;
+    bool resume = false;
+    for (s32 arg_i = 2; arg_i < argc; arg_i++) {
+        if (!strcmp(argv[arg_i], "-portfolio") && arg_i+1 < argc) {
+            portfolio_runs = atoi(argv[++arg_i]);
+        } else if (!strcmp(argv[arg_i], "-jobs") && arg_i+1 < argc) {
+            jobs = atoi(argv[++arg_i]);
+        } else if (!strcmp(argv[arg_i], "-populate")) {
+            context_flags |= CONTEXT_POPULATE;
+        } else if (!strcmp(argv[arg_i], "-huge-pages")) {
+            context_flags |= CONTEXT_HUGE_PAGES;
+        } else if (!strcmp(argv[arg_i], "-numa")) {
+            context_flags |= CONTEXT_NUMA;
+        } else if (!strcmp(argv[arg_i], "-counters")) {
+            context_flags |= CONTEXT_COUNTERS;
+        } else if (!strcmp(argv[arg_i], "-phases")) {
+            print_phases = true;
+        } else if (!strcmp(argv[arg_i], "-double-stranded")) {
+            double_stranded = true;
+        } else if (!strcmp(argv[arg_i], "-steady-state")) {
+            steady_state = true;
+        } else if (!strcmp(argv[arg_i], "-tasks")) {
+            tasks = true;
+        } else if (!strcmp(argv[arg_i], "-pipeline")) {
+            pipeline = true;
+        } else if (!strcmp(argv[arg_i], "-trace") && arg_i+1 < argc) {
+            trace_dir = argv[++arg_i];
+        } else if (!strcmp(argv[arg_i], "-timeline") && arg_i+1 < argc) {
+            timeline_dir = argv[++arg_i];
+        } else if (!strcmp(argv[arg_i], "-checkpoint") && arg_i+1 < argc) {
+            checkpoint_dir = argv[++arg_i];
+        } else if (!strcmp(argv[arg_i], "-resume")) {
+            resume = true;
+        }
+    }
+
+    // either one of the instance sets or any directory of spectrum files
+    char *problem_dir_path = argv[1];
+    if (argv[1][0] >= '0' && argv[1][0] <= '3' && !argv[1][1]) {
+        problem_dir_path = problem_dirs[atoi(argv[1])];
+    }
+    Job *job_list = list_jobs(problem_dir_path);
+    s32 job_count = stb_arr_len(job_list);
+    // a checkpoint only resumes a solve with the same seed, so a rerun of the
+    // batch has to give every file the seed it had before
+    if (checkpoint_dir) {
+        for (s32 i = 0; i < job_count; i++) job_list[i].seed = stb_hash(job_list[i].name);
+    }
+
+    // jobs workers solve whole files, the remaining cores go to the team
+    // inside each solve
+    s32 cores = core_count();
+    jobs = stb_max(1, stb_min(jobs, job_count));
+    s32 inner_threads = stb_max(1, cores / jobs);
+
+    // every worker reuses one solver context for all of its files. with -tasks
+    // or -pipeline they come from a list instead, see below
+    s32 context_count = tasks || pipeline ? 0 : jobs;
+    Solver_Context **contexts = (Solver_Context **)malloc(jobs * sizeof(Solver_Context *));
+    for (s32 i = 0; i < context_count; i++) {
+        contexts[i] = create_solver_context(context_flags);
+    }
+
+    // with -phases every line gets the time of each phase, summed over threads,
+    // and the share of children the fitness cache saved scoring
+    if (print_phases) {
+        printf("name;score;time");
+        for (s32 phase = 0; phase < PHASE_COUNT; phase++) printf(";%s", phase_name(phase));
+        printf(";cache_hits\n");
+    }
+
+    // with -counters the hardware counters of every phase follow each line,
+    // empty where the system doesn't allow them
+    if (context_flags & CONTEXT_COUNTERS) {
+        printf("counters;name;thread;phase");
+        for (s32 counter = 0; counter < COUNTER_COUNT; counter++) {
+            printf(";%s", counter_name(counter));
+        }
+        printf("\n");
+    }
+
+    bool counters_warned = false;
+    std::mutex print_lock;
+    // maps the file of item->job and sets up its params
+    auto load_item = [&](Batch_Item *item) {
+        Job *job = item->job;
+        stb_snprintf(item->path, 1024, "%s/%s", problem_dir_path, job->name);
+
+        u64 load_start = stm_now();
+        if (!load_spectrum(item->path, &item->spectrum)) {
+            job->failed = true;
+            return false;
+        }
+        item->load_ms = stm_ms(stm_since(load_start));
+        if (item->spectrum.original_length) {
+            job->original_oncts = item->spectrum.original_length;
+        }
+
+        Solve_Params params = default_params(job->seed);
+        params.threads = inner_threads;
+        params.double_stranded = double_stranded;
+        params.steady_state = steady_state;
+        params.tasks = tasks;
+        // a convergence trace per instance, dir/name.csv
+        if (trace_dir) {
+            stb_snprintf(item->trace_path, 1024, "%s/%s.csv", trace_dir, job->name);
+            params.trace_path = item->trace_path;
+        }
+        // and a chrome trace of the threads, dir/name.json
+        if (timeline_dir) {
+            stb_snprintf(item->timeline_path, 1024, "%s/%s.json", timeline_dir, job->name);
+            params.timeline_path = item->timeline_path;
+        }
+        // checkpoints of unfinished instances, dir/name.checkpoint. with
+        // -resume a rerun of the batch picks them up
+        if (checkpoint_dir) {
+            stb_snprintf(item->checkpoint_path, 1024, "%s/%s.checkpoint", checkpoint_dir,
+                         job->name);
+            params.checkpoint_path = item->checkpoint_path;
+            params.resume = resume;
+        }
+        item->params = params;
+        return true;
+    };
+
+    auto begin_item = [&](Batch_Item *item) {
+        bool begun = begin_solve(item->context, &item->spectrum, item->job->original_oncts,
+                                 stb_max(portfolio_runs, 1), &item->params);
+        if (!begun) {
+            fprintf(stderr, "%s: not solved\n", item->path);
+            item->job->failed = true;
+            free_spectrum(&item->spectrum);
+        }
+        return begun;
+    };
+
+    auto finish_item = [&](Batch_Item *item) {
+        Job *job = item->job;
+        Solve_Result result;
+        bool solved = end_solve(item->context, &result);
+        free_spectrum(&item->spectrum);
+        if (!solved) {
+            fprintf(stderr, "%s: not solved\n", item->path);
+            job->failed = true;
+            return;
+        }
+        job->percent_score = result.percent_score;
+        job->elapsed = result.elapsed_ms;
+        job->memory_size = result.memory_size;
+        job->huge_page_bytes = result.huge_page_bytes;
+        result.phase_ms[PHASE_LOAD] = item->load_ms;
+        memcpy(job->phase_ms, result.phase_ms, sizeof(job->phase_ms));
+        job->cache_lookups = result.cache_lookups;
+        job->cache_hits = result.cache_hits;
+        {
+            std::lock_guard<std::mutex> guard(print_lock);
+            printf("%s;%f%%;%fms", job->name, result.percent_score, result.elapsed_ms);
+            for (s32 phase = 0; print_phases && phase < PHASE_COUNT; phase++) {
+                printf(";%fms", result.phase_ms[phase]);
+            }
+            if (print_phases) {
+                printf(";%f%%", result.cache_lookups ?
+                                100*(double)result.cache_hits / result.cache_lookups : 0);
+            }
+            printf("\n");
+            if (context_flags & CONTEXT_COUNTERS) {
+                if (!result.counters_available && !counters_warned) {
+                    fprintf(stderr, "no hardware counters available "
+                                    "(check /proc/sys/kernel/perf_event_paranoid)\n");
+                    counters_warned = true;
+                }
+                print_counters(job->name, &result);
+            }
+        }
+        //printf("%s;%f%%;%s\n", job->name, result.percent_score, result.sequence);
+    };
+
+    auto solve_job = [&](Job *job, Solver_Context *context) {
+        Batch_Item item = {};
+        item.job = job;
+        item.context = context;
+        if (load_item(&item) && begin_item(&item)) finish_item(&item);
+    };
+
+    if (pipeline) {
+        // enough items that every stage and queue can be full at once
+        s32 item_count = jobs + 2*PIPELINE_DEPTH + 2;
+        Batch_Item *items = (Batch_Item *)calloc(item_count, sizeof(Batch_Item));
+        Pipe idle, loaded, built;
+        pipe_init(&idle, item_count);
+        pipe_init(&loaded, PIPELINE_DEPTH);
+        pipe_init(&built, PIPELINE_DEPTH);
+        for (s32 i = 0; i < item_count; i++) {
+            items[i].context = create_solver_context(context_flags);
+            pipe_push(&idle, &items[i]);
+        }
+
+        std::thread loader([&] {
+            for (s32 job_i = 0; job_i < job_count; job_i++) {
+                Batch_Item *item = pipe_pop(&idle);
+                Solver_Context *context = item->context;
+                memset(item, 0, sizeof(Batch_Item));
+                item->context = context;
+                item->job = &job_list[job_i];
+                if (load_item(item)) pipe_push(&loaded, item);
+                else pipe_push(&idle, item);
+            }
+            pipe_close(&loaded);
+        });
+        std::thread builder([&] {
+            while (Batch_Item *item = pipe_pop(&loaded)) {
+                if (begin_item(item)) pipe_push(&built, item);
+                else pipe_push(&idle, item);
+            }
+            pipe_close(&built);
+        });
+#pragma omp parallel num_threads(jobs)
+        while (Batch_Item *item = pipe_pop(&built)) {
+            finish_item(item);
+            pipe_push(&idle, item);
+        }
+        loader.join();
+        builder.join();
+
+        for (s32 i = 0; i < item_count; i++) {
+            free_solver_context(items[i].context);
+        }
+        free(items);
+        pipe_free(&idle);
+        pipe_free(&loaded);
+        pipe_free(&built);
+    } else if (tasks) {
+        // every file is a task of the pool, and the solves put their own
+        // loops on it too. a file may run on any worker, so contexts come from
+        // a list instead of per thread. a worker only starts a file when it is
+        // idle, so there are never more of them than workers
+        std::mutex context_lock;
+        Solver_Context **free_contexts = 0;
+        task_parallel_for(0, job_count, 1, [&](s64 begin, s64 end) {
+            for (s64 job_i = begin; job_i < end; job_i++) {
+                Solver_Context *context = 0;
+                {
+                    std::lock_guard<std::mutex> guard(context_lock);
+                    if (stb_arr_len(free_contexts)) context = stb_arr_pop(free_contexts);
+                }
+                if (!context) context = create_solver_context(context_flags);
+                solve_job(&job_list[job_i], context);
+                std::lock_guard<std::mutex> guard(context_lock);
+                stb_arr_push(free_contexts, context);
+            }
+        });
+        for (s32 i = 0; i < stb_arr_len(free_contexts); i++) {
+            free_solver_context(free_contexts[i]);
+        }
+        stb_arr_free(free_contexts);
+    } else {
+        std::atomic<s32> next_job(0);
+#pragma omp parallel num_threads(jobs)
+        for (;;) {
+            s32 job_i = next_job++;
+            if (job_i >= job_count) break;
+#ifdef _OPENMP
+            solve_job(&job_list[job_i], contexts[omp_get_thread_num()]);
+#else
+            solve_job(&job_list[job_i], contexts[0]);
+#endif
+        }
     }
 
     // calculate average score and time
 #if 1
     double sum_score = 0;
-    for (s32 i = 0; i < stb_arr_len(scores); i++) {
-        sum_score += scores[i];
-    }
     double sum_time = 0;
-    for (s32 i = 0; i < stb_arr_len(times); i++) {
-        sum_time += times[i];
+    double sum_phases[PHASE_COUNT] = {};
+    s64 sum_lookups = 0;
+    s64 sum_hits = 0;
+    s32 solved_count = 0;
+    for (s32 i = 0; i < job_count; i++) {
+        if (job_list[i].failed) continue;
+        sum_score += job_list[i].percent_score;
+        sum_time += job_list[i].elapsed;
+        for (s32 phase = 0; phase < PHASE_COUNT; phase++) {
+            sum_phases[phase] += job_list[i].phase_ms[phase];
+        }
+        sum_lookups += job_list[i].cache_lookups;
+        sum_hits += job_list[i].cache_hits;
+        solved_count++;
+    }
+    if (solved_count) {
+        double average_score = sum_score / solved_count;
+        double average_time = sum_time / solved_count;
+        //puts("______________________________________________");
+        printf("average;%f%%;%fms", average_score, average_time);
+        for (s32 phase = 0; print_phases && phase < PHASE_COUNT; phase++) {
+            printf(";%fms", sum_phases[phase] / solved_count);
+        }
+        // over all children of all files
+        if (print_phases) printf(";%f%%", sum_lookups ? 100*(double)sum_hits / sum_lookups : 0);
+        printf("\n");
+    } else {
+        fprintf(stderr, "%s: nothing solved\n", problem_dir_path);
     }
-    double average_score = sum_score / stb_arr_len(scores);
-    double average_time = sum_time / stb_arr_len(times);
-    //puts("______________________________________________");
-    printf("average;%f%%;%fms\n", average_score, average_time);
 #endif
-        
+
+    // how much of the solver memory the kernel really gave huge pages for
+    if ((context_flags & CONTEXT_HUGE_PAGES) && solved_count) {
+        double sum_memory = 0;
+        double sum_huge = 0;
+        for (s32 i = 0; i < job_count; i++) {
+            if (job_list[i].failed) continue;
+            sum_memory += job_list[i].memory_size;
+            sum_huge += job_list[i].huge_page_bytes;
+        }
+        printf("huge pages;%f%%;%fMB\n", sum_memory ? 100*sum_huge / sum_memory : 0,
+               sum_huge / solved_count / (1024*1024));
+    }
+
+    for (s32 i = 0; i < context_count; i++) {
+        free_solver_context(contexts[i]);
+    }
+    free(contexts);
     return 0;
 }
@@ -7,7 +7,11 @@ where cl >nul 2>nul
 if %ERRORLEVEL% neq 0 call %VCVARSPATH%
 
 mkdir build >nul 2>nul
-cl /nologo /Zi /MT /O2 /Oi /F10485760 /openmp main.cpp
+cl /nologo /Zi /MT /O2 /Oi /openmp /c sbh.cpp spectrum.cpp
+lib /nologo /out:sbh.lib sbh.obj spectrum.obj
+cl /nologo /Zi /MT /O2 /Oi /F10485760 /openmp main.cpp sbh.lib
+cl /nologo /Zi /MT /O2 /Oi /openmp bench.cpp spectrum.obj
+cl /nologo /Zi /MT /O2 /Oi /openmp generate.cpp sbh.lib
 move *.obj build >nul 2>nul
 move *.pdb build >nul 2>nul
 move *.ilk build >nul 2>nul
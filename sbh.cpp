@@ -0,0 +1,2881 @@
+// fast configuration
+#if 0
+#define POPULATION  512
+#define GENERATIONS 8
+#define PARENTS     (POPULATION/16)
+#define BREED
+//#define SPARSE_GRAPH
+#define MUTATIONS 1
+//#define OPTIMIZE_GRAPH
+#define FITNESS_CACHE // with one mutation many children are copies, see score_child
+#endif
+
+// normal configuration
+#if 1
+#define POPULATION  (1024*2)
+#define GENERATIONS (1024*8)
+#define PARENTS     (POPULATION/4)
+#define BREED
+//#define SPARSE_GRAPH
+#define MUTATIONS 8
+#define OPTIMIZE_GRAPH
+//#define FITNESS_CACHE // under 1% of children are copies with 8 mutations
+#endif
+
+#define PARALLEL
+#define PHASE_TIMERS
+#define DE_BRUIJN // solve spectra without positive errors as an Eulerian path
+#define SIMD_OVERLAP // vectorized overlaps for the graph, picked by what the cpu supports
+
+#include <stdio.h>
+#include <assert.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#endif
+
+// libnuma is only used when the build found it (see the Makefile), otherwise
+// node placement relies on first touch alone
+#ifdef SBH_LIBNUMA
+#include <numa.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// the vector kernels are x64 only, SSE2 is always there and AVX2 is checked
+#if defined(SIMD_OVERLAP) && !(defined(__x86_64__) || defined(_M_X64))
+#undef SIMD_OVERLAP
+#endif
+#ifdef SIMD_OVERLAP
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#define STB_DEFINE
+#define STB_NO_REGISTRY
+#include "stb.h"
+
+// platform independent high precision timer
+#define SOKOL_IMPL
+#include "sokol_time.h"
+
+#include "sbh.h"
+
+// the solver keeps per node state in fixed size arrays, so a spectrum can have
+// at most MAX_NODES-1 oligos
+#define MAX_NODES 1024
+#define MAX_NUMA_NODES 8
+
+struct Edge {
+    s32 next; // connected node index
+    s32 cost; // how many nonoverlapping oncts are added to the solution
+};
+
+struct Node {
+    Edge *edges;
+    s32 edge_count;
+};
+
+struct Score {
+    s32 oncts;
+    s32 index;
+    u64 hash; // of the candidate's genes, see gene_hash
+};
+
+// stb_intcmp keeps the field offset in a global, so it can't be used when
+// several instances are solved at the same time
+int edge_cost_cmp(const void *a, const void *b) {
+    s32 cost_a = ((Edge *)a)->cost;
+    s32 cost_b = ((Edge *)b)->cost;
+    return (cost_a > cost_b) - (cost_a < cost_b);
+}
+
+int score_cmp_desc(const void *a, const void *b) {
+    s32 oncts_a = ((Score *)a)->oncts;
+    s32 oncts_b = ((Score *)b)->oncts;
+    return (oncts_a < oncts_b) - (oncts_a > oncts_b);
+}
+
+struct Rng {
+    u64 state;
+};
+
+Rng rng_seed(u64 seed) {
+    // splitmix64, so that nearby seeds give unrelated streams
+    u64 z = seed + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    Rng rng;
+    rng.state = (z ^ (z >> 31)) | 1;
+    return rng;
+}
+
+// xorshift64*
+u32 rng_next(Rng *rng) {
+    u64 x = rng->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng->state = x;
+    return (u32)((x * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+// uniform in [0, 1)
+double rng_frand(Rng *rng) {
+    return rng_next(rng) / 4294967296.0;
+}
+
+// index in the OpenMP team, or of the worker of the task pool outside of one
+s32 thread_index() {
+#ifdef _OPENMP
+    if (omp_in_parallel()) return omp_get_thread_num();
+#endif
+    return stb_max(task_worker_index(), 0);
+}
+
+// number of NUMA nodes of the machine, 1 when it can't be told
+s32 numa_node_count() {
+    static s32 count = [] {
+        s32 result = 1;
+#if defined(SBH_LIBNUMA)
+        if (numa_available() >= 0) result = numa_max_node() + 1;
+#elif defined(_WIN32)
+        ULONG highest_node;
+        if (GetNumaHighestNodeNumber(&highest_node)) result = highest_node + 1;
+#elif defined(__linux__)
+        // "0" or "0-1" or "0,2-3"
+        FILE *f = fopen("/sys/devices/system/node/online", "r");
+        if (f) {
+            char line[256] = {};
+            if (fgets(line, sizeof(line), f)) {
+                char *last = stb_strrchr2(line, '-', ',');
+                result = atoi(last ? last+1 : line) + 1;
+            }
+            fclose(f);
+        }
+#endif
+        return stb_clamp(result, 1, MAX_NUMA_NODES);
+    }();
+    return count;
+}
+
+// node of the cpu the calling thread runs on right now
+s32 current_numa_node() {
+    if (numa_node_count() == 1) return 0;
+    s32 node = 0;
+#if defined(SBH_LIBNUMA)
+    node = numa_node_of_cpu(sched_getcpu());
+#elif defined(_WIN32)
+    UCHAR win_node;
+    if (GetNumaProcessorNode((UCHAR)GetCurrentProcessorNumber(), &win_node)) node = win_node;
+#elif defined(__linux__)
+    unsigned cpu, linux_node;
+    if (syscall(SYS_getcpu, &cpu, &linux_node, 0) == 0) node = linux_node;
+#endif
+    return node >= 0 && node < numa_node_count() ? node : 0;
+}
+
+s32 core_count() {
+#ifdef _OPENMP
+    return omp_get_num_procs();
+#else
+    return 1;
+#endif
+}
+
+//
+// work stealing task pool, see task_parallel_for. the workers are plain
+// std::threads, one per core, created on first use and kept for the life of
+// the process. every worker owns a Chase-Lev deque: it pushes and pops at the
+// bottom, thieves take from the top. threads outside the pool hand their
+// loops in through a locked list and sleep until they are done
+//
+
+#define TASK_DEQUE_CAPACITY 1024
+#define TASK_SPINS          64 // failed steal rounds before a worker sleeps
+
+struct Task_Loop {
+    Task_Function *function;
+    void *data;
+    s64 grain;
+    std::atomic<s64> pending; // tasks pushed and not finished yet
+    bool outside; // started by a thread outside the pool
+    Task_Loop *parent; // the loop of the piece that started this one
+};
+
+struct Task {
+    Task_Loop *loop;
+    Task_Loop *parent; // a copy of loop->parent, see helps
+    s64 begin;
+    s64 end;
+};
+
+struct alignas(64) Task_Deque {
+    std::atomic<s64> top;
+    alignas(64) std::atomic<s64> bottom;
+    Task tasks[TASK_DEQUE_CAPACITY];
+};
+
+struct Task_Pool {
+    s32 worker_count;
+    Task_Deque *deques;
+
+    std::mutex lock; // guards injected and the sleeping workers
+    std::condition_variable wake;
+    std::condition_variable finished; // a loop from outside is done
+    Task *injected;  // stb_arr
+    std::atomic<s32> injected_count;
+    std::atomic<s32> sleeping;
+    std::atomic<u64> pushed; // tasks ever pushed, so sleepers can't miss one
+};
+
+thread_local s32 task_worker = -1;
+thread_local Task_Loop *task_loop; // of the piece the worker is running
+
+// a worker waiting for loop only runs pieces of it and of loops started inside
+// them. any other task could be a whole solve that keeps it from returning.
+// only compares pointers, the loop of a task a thief lost may be gone already
+inline bool helps(Task *task, Task_Loop *loop) {
+    return !loop || task->loop == loop || task->parent == loop;
+}
+
+// false when the deque is full, the owner then runs the task itself
+bool deque_push(Task_Deque *deque, Task task) {
+    s64 bottom = deque->bottom.load(std::memory_order_relaxed);
+    s64 top = deque->top.load(std::memory_order_acquire);
+    if (bottom - top >= TASK_DEQUE_CAPACITY) return false;
+    deque->tasks[bottom % TASK_DEQUE_CAPACITY] = task;
+    std::atomic_thread_fence(std::memory_order_release);
+    deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+// owner only
+bool deque_pop(Task_Deque *deque, Task *out) {
+    s64 bottom = deque->bottom.load(std::memory_order_relaxed) - 1;
+    deque->bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    s64 top = deque->top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+    *out = deque->tasks[bottom % TASK_DEQUE_CAPACITY];
+    if (top < bottom) return true;
+    // the last task, a thief may be taking it at the same time
+    bool won = deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed);
+    deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+    return won;
+}
+
+// with waiting_for only a task that helps it, see helps
+bool deque_steal(Task_Deque *deque, Task *out, Task_Loop *waiting_for = 0) {
+    s64 top = deque->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    s64 bottom = deque->bottom.load(std::memory_order_acquire);
+    if (top >= bottom) return false;
+    *out = deque->tasks[top % TASK_DEQUE_CAPACITY];
+    if (!helps(out, waiting_for)) return false;
+    return deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed);
+}
+
+void wake_worker(Task_Pool *pool) {
+    pool->pushed.fetch_add(1);
+    if (pool->sleeping.load()) {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        pool->wake.notify_one();
+    }
+}
+
+// waiting_for as in deque_steal, 0 for any task
+bool find_task(Task_Pool *pool, s32 worker, Rng *rng, Task *out, Task_Loop *waiting_for = 0) {
+    // the tasks the worker pushed while it waits are all of the loop it waits
+    // for, older ones below them are not
+    Task_Deque *own = &pool->deques[worker];
+    s64 bottom = own->bottom.load(std::memory_order_relaxed);
+    if ((!waiting_for || (bottom > own->top.load(std::memory_order_acquire) &&
+                          helps(&own->tasks[(bottom-1) % TASK_DEQUE_CAPACITY], waiting_for))) &&
+        deque_pop(own, out)) {
+        return true;
+    }
+    // loops from outside the pool never help one inside it
+    if (!waiting_for && pool->injected_count.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        if (stb_arr_len(pool->injected)) {
+            *out = stb_arr_pop(pool->injected);
+            pool->injected_count--;
+            return true;
+        }
+    }
+    s32 first = rng_next(rng) % pool->worker_count;
+    for (s32 i = 0; i < pool->worker_count; i++) {
+        s32 victim = (first + i) % pool->worker_count;
+        if (victim != worker && deque_steal(&pool->deques[victim], out, waiting_for)) return true;
+    }
+    return false;
+}
+
+// halves the range and leaves the upper halves for thieves until a piece is
+// small enough, so ranges only get split as far as there are idle workers to
+// take them
+void run_task(Task_Pool *pool, Task task) {
+    Task_Loop *loop = task.loop;
+    Task_Deque *deque = &pool->deques[task_worker];
+    while (task.end - task.begin > loop->grain) {
+        Task upper = task;
+        upper.begin = task.begin + (task.end - task.begin) / 2;
+        loop->pending.fetch_add(1);
+        if (!deque_push(deque, upper)) {
+            loop->pending.fetch_sub(1);
+            break;
+        }
+        wake_worker(pool);
+        task.end = upper.begin;
+    }
+    Task_Loop *outer = task_loop;
+    task_loop = loop;
+    for (s64 begin = task.begin; begin < task.end; begin += loop->grain) {
+        loop->function(loop->data, begin, stb_min(begin + loop->grain, task.end));
+    }
+    task_loop = outer;
+    // the loop lives on the stack of its caller, which may return as soon as
+    // pending is 0
+    bool outside = loop->outside;
+    if (loop->pending.fetch_sub(1, std::memory_order_acq_rel) == 1 && outside) {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        pool->finished.notify_all();
+    }
+}
+
+void task_worker_main(Task_Pool *pool, s32 worker) {
+    task_worker = worker;
+    Rng rng = rng_seed(worker);
+    for (;;) {
+        Task task;
+        u64 pushed = pool->pushed.load();
+        bool found = false;
+        for (s32 spin = 0; spin < TASK_SPINS && !found; spin++) {
+            found = find_task(pool, worker, &rng, &task);
+            if (!found) std::this_thread::yield();
+        }
+        if (found) {
+            run_task(pool, task);
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(pool->lock);
+        pool->sleeping++;
+        pool->wake.wait(guard, [&] { return pool->pushed.load() != pushed; });
+        pool->sleeping--;
+    }
+}
+
+Task_Pool * task_pool() {
+    static Task_Pool *pool = [] {
+        Task_Pool *result = new Task_Pool();
+        result->worker_count = core_count();
+        result->deques = new Task_Deque[result->worker_count]();
+        for (s32 i = 0; i < result->worker_count; i++) {
+            std::thread(task_worker_main, result, i).detach();
+        }
+        return result;
+    }();
+    return pool;
+}
+
+s32 task_worker_count() {
+    return task_pool()->worker_count;
+}
+
+s32 task_worker_index() {
+    return task_worker;
+}
+
+void task_parallel_for(s64 begin, s64 end, s64 grain, Task_Function *function, void *data) {
+    if (begin >= end) return;
+    Task_Pool *pool = task_pool();
+    Task_Loop loop;
+    loop.function = function;
+    loop.data = data;
+    loop.grain = stb_max(grain, (s64)1);
+    loop.pending = 1;
+    loop.outside = task_worker < 0;
+    loop.parent = loop.outside ? 0 : task_loop;
+    Task task = {&loop, loop.parent, begin, end};
+
+    if (loop.outside) {
+        {
+            std::lock_guard<std::mutex> guard(pool->lock);
+            stb_arr_push(pool->injected, task);
+            pool->injected_count++;
+        }
+        wake_worker(pool);
+        std::unique_lock<std::mutex> guard(pool->lock);
+        pool->finished.wait(guard, [&] { return loop.pending.load() == 0; });
+        return;
+    }
+
+    // a worker helps with the pieces of the loop while it waits, and with
+    // loops nested in them, so loops nest without blocking a worker
+    run_task(pool, task);
+    Rng rng = rng_seed((u64)&loop);
+    while (loop.pending.load(std::memory_order_acquire)) {
+        if (find_task(pool, task_worker, &rng, &task, &loop)) {
+            run_task(pool, task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+//
+// hardware counters. every thread opens one perf event group for itself the
+// first time it counts, and reads all counters of the group with one read. any
+// counter the kernel refuses (no PMU, perf_event_paranoid, not on linux) is
+// left out and reads as 0
+//
+
+struct Perf_Group {
+    bool opened;
+    s32 fds[COUNTER_COUNT];
+    s32 leader;
+    u32 available; // bit per Counter
+    s32 count;
+    s32 order[COUNTER_COUNT]; // Counter of the i-th value of a group read
+};
+
+thread_local Perf_Group perf_group;
+
+#ifdef __linux__
+struct Perf_Event {
+    u32 type;
+    u64 config;
+};
+
+Perf_Event perf_events[COUNTER_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                         (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                         (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+
+void perf_close() {
+    for (s32 i = 0; i < perf_group.count; i++) {
+        close(perf_group.fds[perf_group.order[i]]);
+    }
+}
+#endif
+
+Perf_Group * perf_open() {
+    Perf_Group *group = &perf_group;
+    if (group->opened) return group;
+    group->opened = true;
+    group->leader = -1;
+#ifdef __linux__
+    for (s32 counter = 0; counter < COUNTER_COUNT; counter++) {
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = perf_events[counter].type;
+        attr.config = perf_events[counter].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = group->leader == -1;
+        // this thread, any cpu
+        s32 fd = syscall(SYS_perf_event_open, &attr, 0, -1, group->leader, 0);
+        if (fd < 0) continue;
+        if (group->leader == -1) group->leader = fd;
+        group->fds[counter] = fd;
+        group->order[group->count++] = counter;
+        group->available |= 1 << counter;
+    }
+    if (group->leader != -1) {
+        ioctl(group->leader, PERF_EVENT_IOC_ENABLE, 0);
+        // closes the group when the thread exits
+        static thread_local struct Perf_Closer { ~Perf_Closer() { perf_close(); } } closer;
+        (void)closer;
+    }
+#endif
+    return group;
+}
+
+// current values of all counters of the calling thread
+inline void perf_read(u64 *values) {
+    Perf_Group *group = perf_open();
+    if (group->leader == -1) return;
+#ifdef __linux__
+    u64 buffer[1 + COUNTER_COUNT];
+    if (read(group->leader, buffer, sizeof(buffer)) < (ssize_t)sizeof(u64)) return;
+    for (s32 i = 0; i < (s32)buffer[0] && i < group->count; i++) {
+        values[group->order[i]] = buffer[1 + i];
+    }
+#endif
+}
+
+//
+// phase timers. every thread adds to its own cache lines of counters, which
+// are summed after the solve, so timing needs no locks or atomics
+//
+
+struct alignas(64) Phase_Times {
+    u64 ticks[PHASE_COUNT];
+    bool counting; // also read the hardware counters
+    u64 counters[PHASE_COUNT][COUNTER_COUNT];
+    u64 cache_lookups; // children looked up in the fitness cache
+    u64 cache_hits;
+};
+
+struct Phase_Timer {
+#ifdef PHASE_TIMERS
+    Phase_Times *times;
+    s32 phase;
+    u64 start;
+    u64 start_counters[COUNTER_COUNT];
+    Phase_Timer(Phase_Times *times, s32 phase) : times(times), phase(phase) {
+        if (times->counting) {
+            memset(start_counters, 0, sizeof(start_counters));
+            perf_read(start_counters);
+        }
+        start = stm_now();
+    }
+    ~Phase_Timer() {
+        times->ticks[phase] += stm_since(start);
+        if (times->counting) {
+            u64 end_counters[COUNTER_COUNT] = {};
+            perf_read(end_counters);
+            for (s32 i = 0; i < COUNTER_COUNT; i++) {
+                times->counters[phase][i] += end_counters[i] - start_counters[i];
+            }
+        }
+    }
+#else
+    Phase_Timer(Phase_Times *, s32) {}
+#endif
+};
+
+#define TIME_PHASE_(times, phase, line) Phase_Timer phase_timer_##line(times, phase)
+#define TIME_PHASE__(times, phase, line) TIME_PHASE_(times, phase, line)
+// times the rest of the enclosing scope
+#define TIME_PHASE(times, phase) TIME_PHASE__(times, phase, __LINE__)
+
+char * phase_name(s32 phase) {
+    static char *names[PHASE_COUNT] = {
+        "load", "de_bruijn", "overlap", "edge_sort", "optimize_graph",
+        "init", "selection", "crossover", "scoring",
+    };
+    return phase >= 0 && phase < PHASE_COUNT ? names[phase] : (char *)"";
+}
+
+char * counter_name(s32 counter) {
+    static char *names[COUNTER_COUNT] = {
+        "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "dtlb_misses",
+    };
+    return counter >= 0 && counter < COUNTER_COUNT ? names[counter] : (char *)"";
+}
+
+//
+// memory of a solver context. all buffers of one solve are carved out of a
+// single block, which is only replaced when a solve needs more than any solve
+// before it. in steady state a batch doesn't allocate and doesn't fault
+//
+
+#define ARENA_ALIGNMENT   64
+#define ARENA_GRANULARITY (2*1024*1024)
+
+inline size_t align_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+struct Arena {
+    u8 *base;
+    size_t capacity;
+    size_t used;
+    u32 flags; // CONTEXT_ flags
+    s32 grow_count;
+    u32 huge_pages; // HUGE_PAGES_ kind backing the block
+};
+
+// the population and the graph are read at random parent indices every
+// generation, so on big spectra 4 KB pages miss the TLB all the time. with
+// CONTEXT_HUGE_PAGES the block asks for 2 MB pages: reserved ones
+// (MAP_HUGETLB, MEM_LARGE_PAGES) when the system has them, otherwise
+// transparent ones through madvise, otherwise it falls back to normal pages
+void * os_alloc(size_t size, u32 flags, u32 *huge_pages) {
+    *huge_pages = HUGE_PAGES_NONE;
+#ifdef _WIN32
+    if (flags & CONTEXT_HUGE_PAGES) {
+        size_t large_page = GetLargePageMinimum();
+        if (large_page && size % large_page == 0) {
+            void *result = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                        PAGE_READWRITE);
+            if (result) {
+                *huge_pages = HUGE_PAGES_RESERVED;
+                return result;
+            }
+        }
+    }
+    return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    // with CONTEXT_NUMA the pages must be first touched by the threads that
+    // use them, so they are never prefaulted here
+    if (flags & CONTEXT_NUMA) flags &= ~CONTEXT_POPULATE;
+    int map_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+    if (flags & CONTEXT_POPULATE) map_flags |= MAP_POPULATE;
+#endif
+    if (!(flags & CONTEXT_HUGE_PAGES)) {
+        void *result = mmap(0, size, PROT_READ | PROT_WRITE, map_flags, -1, 0);
+        return result == MAP_FAILED ? 0 : result;
+    }
+
+#ifdef MAP_HUGETLB
+    // fails unless the administrator reserved pages in vm.nr_hugepages
+    void *reserved = mmap(0, size, PROT_READ | PROT_WRITE, map_flags | MAP_HUGETLB, -1, 0);
+    if (reserved != MAP_FAILED) {
+        *huge_pages = HUGE_PAGES_RESERVED;
+        return reserved;
+    }
+#endif
+
+#ifdef MADV_HUGEPAGE
+    // transparent huge pages only back 2 MB aligned ranges, so map one page
+    // more than needed and trim the ends. the block is populated after the
+    // advice, or it would be faulted in with small pages
+    size_t mapped_size = size + ARENA_GRANULARITY;
+    u8 *mapped = (u8 *)mmap(0, mapped_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) return 0;
+    u8 *result = (u8 *)align_up((size_t)mapped, ARENA_GRANULARITY);
+    if (result > mapped) munmap(mapped, result - mapped);
+    if (mapped + mapped_size > result + size) {
+        munmap(result + size, mapped + mapped_size - (result + size));
+    }
+    if (madvise(result, size, MADV_HUGEPAGE) == 0) {
+        *huge_pages = HUGE_PAGES_TRANSPARENT;
+    }
+    if (flags & CONTEXT_POPULATE) {
+        for (size_t offset = 0; offset < size; offset += 4096) {
+            result[offset] = 0;
+        }
+    }
+    return result;
+#else
+    void *result = mmap(0, size, PROT_READ | PROT_WRITE, map_flags, -1, 0);
+    return result == MAP_FAILED ? 0 : result;
+#endif
+#endif
+}
+
+void os_free(void *memory, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, size);
+#endif
+}
+
+// bytes of the block that are actually backed by huge pages right now. the
+// madvise advice is only a hint, the kernel hands out small pages when it has
+// no free 2 MB ones, so transparent pages are counted in /proc/self/smaps
+size_t arena_huge_page_bytes(Arena *arena) {
+    if (arena->huge_pages == HUGE_PAGES_RESERVED) return arena->capacity;
+    if (arena->huge_pages != HUGE_PAGES_TRANSPARENT) return 0;
+    size_t result = 0;
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) return 0;
+    char line[256];
+    bool in_arena = false;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long start, end;
+        if (sscanf(line, "%llx-%llx ", &start, &end) == 2) {
+            in_arena = start >= (size_t)arena->base &&
+                       end <= (size_t)arena->base + arena->capacity;
+            continue;
+        }
+        unsigned long long kb;
+        if (in_arena && sscanf(line, "AnonHugePages: %llu kB", &kb) == 1) {
+            result += kb * 1024;
+        }
+    }
+    fclose(f);
+#endif
+    return result;
+}
+
+// starts a solve that needs at most size bytes. everything pushed by the
+// previous solve is dropped
+bool arena_begin(Arena *arena, size_t size) {
+    arena->used = 0;
+    if (size <= arena->capacity) {
+#ifdef MADV_DONTNEED
+        // the old pages sit on the nodes of the previous solve's partition.
+        // dropping them lets this solve's owners fault them in again locally
+        if ((arena->flags & CONTEXT_NUMA) && numa_node_count() > 1) {
+            madvise(arena->base, arena->capacity, MADV_DONTNEED);
+        }
+#endif
+        return true;
+    }
+
+    if (arena->base) os_free(arena->base, arena->capacity);
+    size_t capacity = align_up(size, ARENA_GRANULARITY);
+    arena->base = (u8 *)os_alloc(capacity, arena->flags, &arena->huge_pages);
+    arena->capacity = arena->base ? capacity : 0;
+    arena->grow_count++;
+    return arena->base != 0;
+}
+
+void * arena_push(Arena *arena, size_t size) {
+    size = align_up(size, ARENA_ALIGNMENT);
+    assert(arena->used + size <= arena->capacity);
+    void *result = arena->base + arena->used;
+    arena->used += size;
+    return result;
+}
+
+void arena_free(Arena *arena) {
+    if (arena->base) os_free(arena->base, arena->capacity);
+    *arena = Arena{};
+}
+
+s32 get_overlap(char *a, char *b, s32 onct_length) {
+    for (s32 overlap = onct_length-1;
+         overlap > 0;
+         overlap--)
+    {
+        char *x = a + onct_length - overlap;
+        s32 i = 0;
+        while (i < overlap && x[i] == b[i]) {
+            i++;
+        }
+        if (i == overlap) return overlap;
+    }
+
+    return 0;
+}
+
+// the visited flag of a node. with both strands, oligo i has the nodes 2i+1
+// (forward) and 2i+2 (reverse complement), which share a flag so only one of
+// them is used
+inline s32 visit_slot(s32 node, s32 strand_shift) {
+    return (node + strand_shift) >> strand_shift;
+}
+
+// the vector kernels load a whole OVERLAP_PADDING bytes of a, so it is copied
+// to a buffer of that size first. b is read one nucleotide at a time
+#define OVERLAP_PADDING 32
+
+typedef s32 (*Overlap_Kernel)(char *a, char *b, s32 onct_length);
+
+#ifdef SIMD_OVERLAP
+inline s32 lowest_bit(u64 x) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (s32)index;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// bit s of shifts stands for an overlap of onct_length-s, which holds when
+// a[s+t] == b[t] for every t < onct_length-s. one compare of a with b[t]
+// checks position t of all shifts at once, and bits past the end of a count
+// as equal. shifts die out after a few nucleotides on real data. the smallest
+// remaining shift is the answer as soon as all of its positions were checked
+s32 get_overlap_sse2(char *a, char *b, s32 onct_length) {
+    __m128i a_v = _mm_loadu_si128((__m128i *)a);
+    u32 past_end = ~0u << onct_length;
+    u32 shifts = ~past_end & ~1u;
+    for (s32 t = 0; t < onct_length-1; t++) {
+        u32 equal = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(a_v, _mm_set1_epi8(b[t])));
+        shifts &= (equal | past_end) >> t;
+        if (!shifts) return 0;
+        s32 s = lowest_bit(shifts);
+        if (s + t >= onct_length-1) return onct_length - s;
+    }
+    return 0;
+}
+
+TARGET_AVX2 s32 get_overlap_avx2(char *a, char *b, s32 onct_length) {
+    __m256i a_v = _mm256_loadu_si256((__m256i *)a);
+    u64 past_end = ~0ull << onct_length;
+    u64 shifts = ~past_end & ~1ull;
+    for (s32 t = 0; t < onct_length-1; t++) {
+        u64 equal = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a_v, _mm256_set1_epi8(b[t])));
+        shifts &= (equal | past_end) >> t;
+        if (!shifts) return 0;
+        s32 s = lowest_bit(shifts);
+        if (s + t >= onct_length-1) return onct_length - s;
+    }
+    return 0;
+}
+
+bool cpu_has_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// the fastest kernel for oligos of this length, all give the same overlaps as
+// get_overlap
+Overlap_Kernel overlap_kernel(s32 onct_length) {
+#ifdef SIMD_OVERLAP
+    if (onct_length <= 16) return get_overlap_sse2;
+    static bool avx2 = cpu_has_avx2();
+    if (onct_length <= 32 && avx2) return get_overlap_avx2;
+#endif
+    return get_overlap;
+}
+
+s32 score_candidate(Edge *candidate, s32 onct_length, s32 max_solution_length, s32 node_count,
+                    s32 strand_shift = 0) {
+    s32 oncts_visited = 0;
+    s32 total_length = onct_length;
+    s32 current = candidate[0].next;
+    u8 visited[MAX_NODES] = {};
+    while (candidate[current].cost) {
+        if (visited[visit_slot(current, strand_shift)]) break;
+        visited[visit_slot(current, strand_shift)] = true;
+        oncts_visited++;
+        if (candidate[current].cost + total_length > max_solution_length) {
+            return oncts_visited;
+        }
+        total_length += candidate[current].cost;
+        current = candidate[current].next;
+        assert(current >= 0 && current < node_count);
+    }
+    return oncts_visited;
+}
+
+// a candidate's hash is the xor of the hashes of its genes, so changing a gene
+// updates it with two xors (Zobrist hashing). the hashes are mixed from the
+// node and the edge instead of looked up, a table would take MAX_NODES^2 of them
+inline u64 gene_hash(s32 node, Edge edge) {
+    // splitmix64 finalizer
+    u64 z = ((u64)(u32)node << 42) ^ ((u64)(u32)edge.next << 16) ^ (u64)(u32)edge.cost;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+u64 candidate_hash(Edge *candidate, s32 node_count) {
+    u64 hash = 0;
+    for (s32 i = 0; i < node_count; i++) hash ^= gene_hash(i, candidate[i]);
+    return hash;
+}
+
+// repairs the candidate in place, replacing edges that would revisit an oligo
+// or make the solution too long. when given, hash is kept up to date with the
+// changes. a repaired candidate comes out unchanged
+s32 optimize_and_score(Edge *candidate, Node *graph, s32 onct_length,
+                       s32 max_solution_length, s32 node_count, s32 strand_shift = 0,
+                       u64 *hash = 0) {
+    s32 oncts_visited = 0;
+    s32 total_length = onct_length;
+    s32 current = candidate[0].next;
+    u8 visited[MAX_NODES] = {};
+    while (candidate[current].cost) {
+        visited[visit_slot(current, strand_shift)] = true;
+        oncts_visited++;
+        Edge edge = candidate[current];
+        bool too_long = edge.cost + total_length > max_solution_length;
+        bool next_visited = visited[visit_slot(edge.next, strand_shift)];
+        if (too_long || next_visited) {
+            // try to find a legal edge
+            s32 i;
+            for (i = 0; i < graph[current].edge_count; i++) {
+                edge = graph[current].edges[i];
+                too_long = edge.cost + total_length > max_solution_length;
+                next_visited = visited[visit_slot(edge.next, strand_shift)];
+                if (!too_long && !next_visited) {
+                    if (hash) *hash ^= gene_hash(current, candidate[current]) ^ gene_hash(current, edge);
+                    candidate[current] = edge;
+                    break;
+                }
+            }
+            if (i == graph[current].edge_count) { // legal edge not found
+                break;
+            }
+        }
+        total_length += edge.cost;
+        current = edge.next;
+        assert(current >= 0 && current < node_count);
+    }
+    return oncts_visited;
+}
+
+// the table optimize_graph takes from the arena while it runs. edges point
+// one past the nodes it is given, so rows have a column more
+inline size_t optimize_graph_size(s32 node_count) {
+    return align_up((size_t)node_count * (node_count + 1) * sizeof(s32), ARENA_ALIGNMENT);
+}
+
+void optimize_graph(Node *graph, s32 node_count, Arena *arena) {
+    // find optimal edges connecting [i] to [j]
+    size_t used = arena->used;
+    s32 stride = node_count + 1;
+    s32 *optimal_edges_table = (s32 *)arena_push(arena, optimize_graph_size(node_count));
+    memset(optimal_edges_table, 0, (size_t)node_count * stride * sizeof(s32));
+    auto optimal_edges = [&](s32 i) { return optimal_edges_table + (size_t)i * stride; };
+    for (s32 node_i = 0; node_i < node_count; node_i++) {
+        Node node = graph[node_i];
+        for (s32 edge_i = 0; edge_i < node.edge_count; edge_i++) {
+            Edge e = node.edges[edge_i];
+            if (e.cost != 1) break;
+            optimal_edges(node_i)[e.next] += 1;
+        }
+    }
+    // search for nodes to merge
+    for (s32 node_i = 0; node_i < node_count; node_i++) {
+        s32 row_sum = 0;
+        s32 dest_j = -1;
+        for (s32 j = 0; j < node_count; j++) {
+            row_sum += optimal_edges(node_i)[j];
+            if (optimal_edges(node_i)[j] > 0) {
+                dest_j = j;
+            }
+            if (row_sum > 1) break;
+        }
+        if (row_sum != 1) continue;
+        s32 col_sum = 0;
+        for (s32 i = 0; i < node_count; i++) {
+            col_sum += optimal_edges(i)[dest_j];
+            if (col_sum > 1) break;
+        }
+        if (col_sum != 1) continue;
+        // at this point we know the nodes can be merged
+        // delete all suboptimal edges from source node
+        {
+            Node *node = &graph[node_i];
+            node->edges[0].next = dest_j;
+            node->edges[0].cost = 1;
+            node->edge_count = 1;
+        }
+
+        // delete all suboptimal edges into dest node
+        for (s32 i = 0; i < node_count; i++) {
+            Node *node = &graph[i];
+            if (i == node_i || i == dest_j) continue;
+            for (s32 edge_i = 0; edge_i < node->edge_count; edge_i++) {
+                if (node->edges[edge_i].next != dest_j) continue;
+
+                s32 remaining_edges = node->edge_count - edge_i - 1;
+                memmove(&node->edges[edge_i],
+                        &node->edges[edge_i+1],
+                        remaining_edges * sizeof(Edge));
+                node->edge_count--;
+                break;
+            }
+        }
+    }
+    // the memory goes to whatever the solve pushes next
+    arena->used = used;
+}
+
+struct Graph {
+    Node *nodes;
+    s32 node_count;
+    s32 onct_length;
+    s32 max_solution_length;
+    s32 optimal_score;
+    s32 strand_shift; // 1 when every oligo has a node per strand, see visit_slot
+    s32 to_mutate[MAX_NODES]; // nodes with more than one edge to choose from
+    s32 to_mutate_count;
+
+    // per NUMA node copies of nodes, 0 where the node uses nodes itself
+    Node *replicas[MAX_NUMA_NODES];
+};
+
+inline size_t graph_size(s32 node_count) {
+    // edges are allocated after the nodes
+    size_t nodes_mem_size = sizeof(Node) * node_count;
+    size_t edges_mem_size = sizeof(Edge) * node_count * (node_count - 1);
+    return nodes_mem_size + edges_mem_size;
+}
+
+// the edges of one oligo node, sorted by cost
+void build_node_edges(Spectrum *spectrum, Node *graph, s32 node_i, Phase_Times *times,
+                      s32 strand_shift) {
+    s32 onct_length = spectrum->onct_length;
+    s32 node_count = spectrum->count + 1;
+    Overlap_Kernel overlap_of = overlap_kernel(onct_length);
+    Node *node = &graph[node_i];
+    node->edges = (Edge *)(graph + node_count) + (size_t)node_i * (node_count - 1);
+    node->edge_count = 0;
+    {
+        TIME_PHASE(times, PHASE_OVERLAP);
+        char padded[OVERLAP_PADDING] = {};
+        char *source = spectrum_oligo(spectrum, node_i-1);
+        if (onct_length <= OVERLAP_PADDING) {
+            memcpy(padded, source, onct_length);
+            source = padded;
+        }
+        for (s32 dest_i = 1; dest_i < node_count; dest_i++) {
+            if (visit_slot(node_i, strand_shift) == visit_slot(dest_i, strand_shift)) continue;
+            s32 overlap = overlap_of(source, spectrum_oligo(spectrum, dest_i-1), onct_length);
+#ifdef SPARSE_GRAPH
+            if (overlap > 0)
+#endif
+            {
+                Edge e;
+                e.next = dest_i;
+                e.cost = onct_length - overlap;
+                node->edges[node->edge_count++] = e;
+            }
+        }
+    }
+
+    // sort edges in the node by cost
+    {
+        TIME_PHASE(times, PHASE_EDGE_SORT);
+        qsort(node->edges, node->edge_count,
+              sizeof(Edge), edge_cost_cmp);
+    }
+}
+
+// nodes built by one task at a time with Solve_Params.tasks
+#define TASK_GRAIN_NODES 8
+
+// builds the overlap graph of the spectrum. node 0 is synthetic, node i+1 is
+// oligo i
+// fills graph, graph_size(spectrum->count + 1) bytes, with the nodes and their
+// edges sorted by cost. every node has room for node_count-1 edges, so nodes
+// can be built in any order. with a strand_shift of 1 the spectrum holds both
+// strands of every oligo (see oriented_spectrum) and the two don't connect
+void build_edges(Spectrum *spectrum, Node *graph, Phase_Times *times,
+                 s32 strand_shift = 0, bool tasks = false) {
+    s32 node_count = spectrum->count + 1;
+    Edge *edges = (Edge *)(graph + node_count);
+
+    // add a synthetic node with 0 cost connections to all other nodes
+    graph[0].edges = edges;
+    graph[0].edge_count = 0;
+    for (s32 dest_i = 1; dest_i < node_count; dest_i++) {
+        Edge e = {};
+        e.next = dest_i;
+        graph[0].edges[graph[0].edge_count++] = e;
+    }
+
+    if (!tasks) {
+        for (s32 node_i = 1; node_i < node_count; node_i++) {
+            build_node_edges(spectrum, graph, node_i, times, strand_shift);
+        }
+        return;
+    }
+
+    // every piece times itself and adds up at the end
+    std::mutex times_lock;
+    task_parallel_for(1, node_count, TASK_GRAIN_NODES, [&](s64 begin, s64 end) {
+        Phase_Times piece_times = {};
+        piece_times.counting = times->counting;
+        for (s64 node_i = begin; node_i < end; node_i++) {
+            build_node_edges(spectrum, graph, (s32)node_i, &piece_times, strand_shift);
+        }
+        std::lock_guard<std::mutex> guard(times_lock);
+        for (s32 phase = 0; phase < PHASE_COUNT; phase++) {
+            times->ticks[phase] += piece_times.ticks[phase];
+            for (s32 i = 0; i < COUNTER_COUNT; i++) {
+                times->counters[phase][i] += piece_times.counters[phase][i];
+            }
+        }
+    });
+}
+
+Graph build_graph(Spectrum *spectrum, s32 original_oncts, Arena *arena,
+                  Phase_Times *times, s32 strand_shift = 0, bool tasks = false) {
+    Graph result = {};
+    s32 onct_length = spectrum->onct_length;
+    s32 node_count = spectrum->count + 1;
+
+    Node *graph = (Node *)arena_push(arena, graph_size(node_count));
+    build_edges(spectrum, graph, times, strand_shift, tasks);
+
+#ifdef OPTIMIZE_GRAPH
+    // pass graph without first synthetic node
+    {
+        TIME_PHASE(times, PHASE_OPTIMIZE_GRAPH);
+        optimize_graph(graph+1, node_count-1, arena);
+    }
+
+    for (s32 node_i = 0; node_i < node_count; node_i++) {
+        if (graph[node_i].edge_count > 1) {
+            result.to_mutate[result.to_mutate_count++] = node_i;
+        }
+    }
+    //printf("%d to mutate\n", result.to_mutate_count);
+#endif
+
+    result.nodes = graph;
+    result.node_count = node_count;
+    result.onct_length = onct_length;
+    result.max_solution_length = original_oncts + onct_length - 1;
+    result.optimal_score = stb_min(spectrum->count >> strand_shift, original_oncts);
+    result.strand_shift = strand_shift;
+    return result;
+}
+
+// dest must have room for graph_size(node_count) bytes
+void copy_graph(Node *dest, Node *source, s32 node_count) {
+    memcpy(dest, source, graph_size(node_count));
+    for (s32 i = 0; i < node_count; i++) {
+        dest[i].edges = (Edge *)((u8 *)dest + ((u8 *)source[i].edges - (u8 *)source));
+    }
+}
+
+// gives every NUMA node its own copy of the read only graph, so mutation and
+// scoring don't read edges across the interconnect. with libnuma the copies are
+// bound to their node, otherwise each one is made by a thread of the team that
+// runs on that node, so first touch places it
+void replicate_graph(Graph *g, Arena *arena, s32 threads) {
+    size_t size = graph_size(g->node_count);
+    s32 home = current_numa_node();
+    Node *copies[MAX_NUMA_NODES] = {};
+    for (s32 n = 0; n < numa_node_count(); n++) {
+        if (n == home) continue;
+        copies[n] = (Node *)align_up((size_t)arena_push(arena, size + 4096), 4096);
+#ifdef SBH_LIBNUMA
+        numa_tonode_memory(copies[n], size, n);
+#endif
+    }
+
+#ifdef SBH_LIBNUMA
+    (void)threads;
+    for (s32 n = 0; n < MAX_NUMA_NODES; n++) {
+        if (!copies[n]) continue;
+        copy_graph(copies[n], g->nodes, g->node_count);
+        g->replicas[n] = copies[n];
+    }
+#else
+    std::atomic<s32> claimed[MAX_NUMA_NODES] = {};
+#ifdef PARALLEL
+#pragma omp parallel num_threads(threads)
+#endif
+    {
+        s32 n = current_numa_node();
+        if (copies[n] && !claimed[n].exchange(1)) {
+            copy_graph(copies[n], g->nodes, g->node_count);
+            g->replicas[n] = copies[n];
+        }
+    }
+#endif
+}
+
+// the copy of the graph closest to the calling thread
+inline Node * thread_graph(Graph *g) {
+    Node *replica = g->replicas[current_numa_node()];
+    return replica ? replica : g->nodes;
+}
+
+// population statistics at the start of one generation
+struct Trace_Row {
+    s32 generation;
+    s32 best;
+    s32 median;
+    double mean;
+    double diversity; // mean share of genes that differ from the best candidate
+    double elapsed_ms;
+};
+
+// candidates of spread out ranks compared with the best for the diversity
+#define TRACE_DIVERSITY_SAMPLES 64
+
+//
+// timeline of what every thread of a run does when, for chrome://tracing or
+// Perfetto. every thread writes its own ring buffer, which keeps the last
+// TIMELINE_CAPACITY spans, and the buffers are written out after the solve
+//
+
+#define TIMELINE_CAPACITY (1 << 14)
+
+enum Timeline_Event_Name {
+    EVENT_INIT,
+    EVENT_SELECTION,    // sorting the scores, master thread only
+    EVENT_PARENTS,      // saving this thread's share of the parents
+    EVENT_PARENTS_BACK, // moving them back to the start of the population
+    EVENT_CHILDREN,     // this thread's chunk of the child loop
+    EVENT_BARRIER,      // waiting for the rest of the team
+    EVENT_BATCH,        // a batch of children of the steady state loop
+    EVENT_COUNT,
+};
+
+struct Timeline_Event {
+    u64 start;
+    u64 end;
+    s32 name;
+    s32 generation;
+};
+
+struct Timeline {
+    Timeline_Event *events;
+    u64 count; // events ever recorded, the ring holds the last ones
+};
+
+inline u64 timeline_begin(Timeline *timeline) {
+    return timeline ? stm_now() : 0;
+}
+
+inline void timeline_end(Timeline *timeline, s32 name, u64 start, s32 generation) {
+    if (!timeline) return;
+    Timeline_Event *event = &timeline->events[timeline->count++ % TIMELINE_CAPACITY];
+    event->start = start;
+    event->end = stm_now();
+    event->name = name;
+    event->generation = generation;
+}
+
+// the barrier at the end of a worksharing loop, made explicit so that the wait
+// shows on the timeline
+inline void timeline_barrier(Timeline *timeline, s32 generation) {
+    u64 start = timeline_begin(timeline);
+#ifdef PARALLEL
+#pragma omp barrier
+#endif
+    timeline_end(timeline, EVENT_BARRIER, start, generation);
+}
+
+// the hashes and scores of the candidates of a generation, see score_child
+#define FITNESS_CACHE_PROBES 8
+#define FITNESS_CACHE_SCORE_BITS 12 // scores are below MAX_NODES
+
+struct Fitness_Cache {
+    // the high bits of the hash with the score in the low bits, 0 when empty.
+    // the slot comes from the low bits of the hash, so they aren't lost
+    std::atomic<u64> *entries;
+    u32 mask;
+};
+
+inline u32 fitness_cache_capacity(s32 population) {
+    u32 capacity = 1;
+    while (capacity < 2 * (u32)population) capacity *= 2;
+    return capacity;
+}
+
+// a candidate of the steady state population. the lock guards the candidate,
+// the score can be read without it. a cache line each, so threads working on
+// neighbouring slots don't contend
+struct alignas(64) Slot {
+    std::atomic<s32> lock;
+    std::atomic<s32> score;
+};
+
+// buffers of one GA run
+struct Run_Workspace {
+    u8 *candidates;
+    Score *scores;
+    Edge *best;
+    s32 best_score;
+    s32 generations;
+    Phase_Times *thread_times; // one per thread of the run's team
+    Trace_Row *trace; // generations+1 rows when params->trace_path is set
+    s32 trace_count;
+    bool counting;    // CONTEXT_COUNTERS
+    Timeline *timelines; // one per thread when params->timeline_path is set
+
+    // when params->checkpoint_path is set, the snapshot a checkpoint is
+    // written from: a Checkpoint_Header, the scores and the candidates
+    u8 *checkpoint;
+    size_t checkpoint_size;
+    u32 graph_hash;
+    s32 resumed_from;
+
+    Fitness_Cache cache; // empty without FITNESS_CACHE and with steady_state
+
+    // with params->steady_state
+    Slot *slots;  // one per candidate
+    u8 *children; // a child candidate per thread
+};
+
+// counters of the calling thread of a run's team
+inline Phase_Times * thread_times(Run_Workspace *workspace, s32 threads) {
+    s32 index = thread_index();
+    return &workspace->thread_times[index < threads ? index : 0];
+}
+
+inline Timeline * thread_timeline(Run_Workspace *workspace, s32 threads) {
+    if (!workspace->timelines) return 0;
+    s32 index = thread_index();
+    return &workspace->timelines[index < threads ? index : 0];
+}
+
+bool write_timeline(char *path, Run_Workspace *workspaces, Solve_Params *params,
+                    s32 runs, u64 start_time) {
+    static char *names[EVENT_COUNT] = {
+        "init", "selection", "parents", "parents back", "children", "barrier", "batch",
+    };
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "%s: can't write timeline\n", path);
+        return false;
+    }
+    fprintf(f, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (s32 run_i = 0; run_i < runs; run_i++) {
+        for (s32 thread = 0; thread < params[run_i].threads; thread++) {
+            fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                       "\"args\":{\"name\":\"run %d thread %d\"}}",
+                    first ? "" : ",\n", run_i, thread, run_i, thread);
+            first = false;
+
+            Timeline *timeline = &workspaces[run_i].timelines[thread];
+            u64 count = timeline->count;
+            u64 oldest = count > TIMELINE_CAPACITY ? count - TIMELINE_CAPACITY : 0;
+            for (u64 i = oldest; i < count; i++) {
+                Timeline_Event *event = &timeline->events[i % TIMELINE_CAPACITY];
+                // microseconds since the solve started
+                double start = stm_us(stm_diff(event->start, start_time));
+                double duration = stm_us(stm_diff(event->end, event->start));
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                           "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"generation\":%d}}",
+                        names[event->name], run_i, thread, start, duration,
+                        event->generation);
+            }
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    return true;
+}
+
+// a solve between begin_solve and end_solve. everything but the spectrum and
+// the paths of the params lives in the arena or here
+struct Pending_Solve {
+    bool active;
+    bool done; // the fast path took it, result is complete
+    Solve_Result result;
+    u64 start_time;
+    double build_ms;
+    s32 grow_count;
+    bool counting;
+    Phase_Times build_times;
+
+    Solve_Params base;
+    Spectrum oriented;
+    Spectrum *graph_spectrum;
+    Graph graph;
+    s32 runs;
+    s32 outer_threads;
+    Solve_Params *params;
+    Run_Workspace *workspaces;
+};
+
+struct Solver_Context {
+    Arena arena;
+    Pending_Solve pending;
+};
+
+Solver_Context * create_solver_context(u32 flags) {
+    stm_setup();
+    Solver_Context *context = new Solver_Context();
+    context->arena.flags = flags;
+    return context;
+}
+
+void free_solver_context(Solver_Context *context) {
+    arena_free(&context->arena);
+    delete context;
+}
+
+//
+// checkpoints
+//
+
+#define CHECKPOINT_MAGIC   0x43484253 // "SBHC"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_EVERY   256 // generations
+
+// followed by population scores and population candidates, as in the workspace
+struct Checkpoint_Header {
+    u32 magic;
+    u32 version;
+    u32 graph_hash; // candidates are edges of one graph, see graph_hash
+    u32 checksum;   // crc32 of the scores and candidates
+    u64 seed;
+    s32 population;
+    s32 parent_count;
+    s32 node_count;
+    s32 generation; // the generation to continue at
+};
+
+// defined in spectrum.cpp
+void * map_file(char *path, size_t *size);
+void unmap_file(void *data, size_t size);
+
+inline size_t checkpoint_size(s32 population, s32 node_count) {
+    return sizeof(Checkpoint_Header) + population * sizeof(Score) +
+           (size_t)population * node_count * sizeof(Edge);
+}
+
+u32 graph_hash(Graph *g) {
+    u32 hash = stb_crc32_block(0, (u8 *)&g->max_solution_length, sizeof(s32));
+    for (s32 i = 0; i < g->node_count; i++) {
+        Node *node = &g->nodes[i];
+        hash = stb_crc32_block(hash, (u8 *)&node->edge_count, sizeof(s32));
+        hash = stb_crc32_block(hash, (u8 *)node->edges, node->edge_count * sizeof(Edge));
+    }
+    return hash;
+}
+
+// runs on a thread of its own while the run goes on. the checkpoint is only
+// replaced once the new one is complete, so a run killed in the middle of a
+// write still has the previous one
+void write_checkpoint(char *path, u8 *snapshot, size_t size, std::atomic<s32> *writing) {
+    Checkpoint_Header *header = (Checkpoint_Header *)snapshot;
+    header->checksum = stb_crc32(snapshot + sizeof(Checkpoint_Header),
+                                 (stb_uint)(size - sizeof(Checkpoint_Header)));
+    char temp_path[1024];
+    stb_snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE *f = fopen(temp_path, "wb");
+    bool ok = f != 0;
+    if (ok) {
+        ok = fwrite(snapshot, size, 1, f) == 1;
+        ok = fclose(f) == 0 && ok;
+    }
+#ifdef _WIN32
+    ok = ok && MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(temp_path, path) == 0;
+#endif
+    if (!ok) fprintf(stderr, "%s: can't write checkpoint\n", path);
+    writing->store(0);
+}
+
+// copies the population, sorted by score, to the snapshot and hands it to a
+// writer thread. skipped while the last checkpoint is still being written, so
+// the run never waits for the disk
+void start_checkpoint(Run_Workspace *workspace, Solve_Params *params, s32 node_count,
+                      s32 generation, std::thread *writer, std::atomic<s32> *writing) {
+    if (writing->load()) return;
+    if (writer->joinable()) writer->join();
+
+    s32 population = params->population;
+    Checkpoint_Header *header = (Checkpoint_Header *)workspace->checkpoint;
+    *header = Checkpoint_Header{};
+    header->magic = CHECKPOINT_MAGIC;
+    header->version = CHECKPOINT_VERSION;
+    header->graph_hash = workspace->graph_hash;
+    header->seed = params->seed;
+    header->population = population;
+    header->parent_count = params->parent_count;
+    header->node_count = node_count;
+    header->generation = generation;
+    u8 *scores = workspace->checkpoint + sizeof(Checkpoint_Header);
+    memcpy(scores, workspace->scores, population * sizeof(Score));
+    memcpy(scores + population * sizeof(Score), workspace->candidates,
+           (size_t)population * node_count * sizeof(Edge));
+
+    writing->store(1);
+    *writer = std::thread(write_checkpoint, params->checkpoint_path, workspace->checkpoint,
+                          workspace->checkpoint_size, writing);
+}
+
+// loads the run's checkpoint into the workspace. returns the generation to
+// continue at, or 0 when there is no checkpoint for this graph and parameters
+s32 read_checkpoint(Run_Workspace *workspace, Solve_Params *params, s32 node_count) {
+    size_t size = 0;
+    u8 *data = (u8 *)map_file(params->checkpoint_path, &size);
+    if (!data) return 0;
+
+    s32 population = params->population;
+    Checkpoint_Header *header = (Checkpoint_Header *)data;
+    u8 *scores = data + sizeof(Checkpoint_Header);
+    bool valid = size == checkpoint_size(population, node_count) &&
+                 header->magic == CHECKPOINT_MAGIC &&
+                 header->version == CHECKPOINT_VERSION &&
+                 header->graph_hash == workspace->graph_hash &&
+                 header->seed == params->seed &&
+                 header->population == population &&
+                 header->parent_count == params->parent_count &&
+                 header->node_count == node_count &&
+                 header->checksum == stb_crc32(scores, (stb_uint)(size - sizeof(Checkpoint_Header)));
+    s32 generation = 0;
+    if (valid) {
+        memcpy(workspace->scores, scores, population * sizeof(Score));
+        memcpy(workspace->candidates, scores + population * sizeof(Score),
+               (size_t)population * node_count * sizeof(Edge));
+        generation = header->generation;
+    } else {
+        fprintf(stderr, "%s: checkpoint is of another solve, starting over\n",
+                params->checkpoint_path);
+    }
+    unmap_file(data, size);
+    return generation;
+}
+
+Solve_Params default_params(u64 seed) {
+    Solve_Params params;
+    params.population = POPULATION;
+    params.generations = GENERATIONS;
+    params.parent_count = PARENTS;
+    params.mutations = MUTATIONS;
+#ifdef BREED
+    params.breed = true;
+#else
+    params.breed = false;
+#endif
+    params.seed = seed;
+    params.threads = 0;
+    params.trace_path = 0;
+    params.timeline_path = 0;
+    params.double_stranded = false;
+    params.checkpoint_path = 0;
+    params.checkpoint_every = CHECKPOINT_EVERY;
+    params.resume = false;
+    params.steady_state = false;
+    params.tasks = false;
+    return params;
+}
+
+// called by the master thread after the scores are sorted
+void trace_generation(Run_Workspace *workspace, s32 gen_index, s32 population,
+                      s32 node_count, u64 start_time) {
+    Score *scores = workspace->scores;
+    s32 candidate_size = node_count * sizeof(Edge);
+    Trace_Row row;
+    row.generation = gen_index;
+    row.best = scores[0].oncts;
+    row.median = scores[population/2].oncts;
+    s64 sum = 0;
+    for (s32 i = 0; i < population; i++) sum += scores[i].oncts;
+    row.mean = (double)sum / population;
+
+    Edge *best = (Edge *)(workspace->candidates + scores[0].index*candidate_size);
+    s32 samples = population > TRACE_DIVERSITY_SAMPLES ? TRACE_DIVERSITY_SAMPLES : population;
+    s64 differing = 0;
+    for (s32 sample_i = 0; sample_i < samples; sample_i++) {
+        s32 rank = (s32)((s64)sample_i * population / samples);
+        Edge *candidate = (Edge *)(workspace->candidates + scores[rank].index*candidate_size);
+        for (s32 i = 0; i < node_count; i++) {
+            differing += candidate[i].next != best[i].next;
+        }
+    }
+    row.diversity = (double)differing / ((s64)samples * node_count);
+    row.elapsed_ms = stm_ms(stm_since(start_time));
+    workspace->trace[workspace->trace_count++] = row;
+}
+
+bool write_trace(char *path, Run_Workspace *workspaces, s32 runs) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "%s: can't write trace\n", path);
+        return false;
+    }
+    fprintf(f, "run;generation;best;mean;median;diversity;elapsed_ms\n");
+    for (s32 run_i = 0; run_i < runs; run_i++) {
+        for (s32 i = 0; i < workspaces[run_i].trace_count; i++) {
+            Trace_Row *row = &workspaces[run_i].trace[i];
+            fprintf(f, "%d;%d;%d;%f;%d;%f;%f\n", run_i, row->generation, row->best,
+                    row->mean, row->median, row->diversity, row->elapsed_ms);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+inline void mutate(Edge *candidate, Graph *g, Node *local_graph, s32 mutations, Rng *rng,
+                   u64 *hash = 0) {
+    for (s32 i = 0; i < mutations; i++) {
+#ifndef OPTIMIZE_GRAPH
+        s32 node_to_mutate = rng_next(rng) % g->node_count;
+#else
+        s32 node_to_mutate = g->to_mutate[rng_next(rng) % g->to_mutate_count];
+#endif
+        Node node = local_graph[node_to_mutate];
+        double rand_v = rng_frand(rng);
+        s32 new_edge = (s32)(rand_v * rand_v * node.edge_count);
+        if (hash) {
+            *hash ^= gene_hash(node_to_mutate, candidate[node_to_mutate]) ^
+                     gene_hash(node_to_mutate, node.edges[new_edge]);
+        }
+        candidate[node_to_mutate] = node.edges[new_edge];
+    }
+}
+
+//
+// fitness cache. with truncation selection and few mutations many children
+// come out as exact copies of a parent or of each other. the cache holds the
+// hashes and scores of the repaired candidates of the current generation, and
+// since repair leaves a repaired candidate as it is, a child found in it needs
+// neither the repair walk nor scoring. it is cleared every generation and
+// filled with the parents, children add themselves as they are scored
+//
+
+inline bool cache_lookup(Fitness_Cache *cache, u64 hash, s32 *score) {
+    u64 tag = hash >> FITNESS_CACHE_SCORE_BITS << FITNESS_CACHE_SCORE_BITS;
+    for (u32 i = 0; i < FITNESS_CACHE_PROBES; i++) {
+        u64 entry = cache->entries[((u32)hash + i) & cache->mask].load(std::memory_order_relaxed);
+        if (!entry) return false;
+        if ((entry ^ tag) >> FITNESS_CACHE_SCORE_BITS == 0) {
+            *score = (s32)(entry & ((1 << FITNESS_CACHE_SCORE_BITS) - 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void cache_insert(Fitness_Cache *cache, u64 hash, s32 score) {
+    u64 entry = hash >> FITNESS_CACHE_SCORE_BITS << FITNESS_CACHE_SCORE_BITS | (u64)score;
+    if (!entry) return;
+    for (u32 i = 0; i < FITNESS_CACHE_PROBES; i++) {
+        std::atomic<u64> *slot = &cache->entries[((u32)hash + i) & cache->mask];
+        u64 expected = 0;
+        if (slot->compare_exchange_strong(expected, entry, std::memory_order_relaxed)) return;
+        if ((expected ^ entry) >> FITNESS_CACHE_SCORE_BITS == 0) return;
+    }
+}
+
+// at the start of a generation, once the parents are the first scores
+void reset_cache(Fitness_Cache *cache, Score *scores, s32 parent_count) {
+    for (u32 i = 0; i <= cache->mask; i++) cache->entries[i].store(0, std::memory_order_relaxed);
+    for (s32 i = 0; i < parent_count; i++) cache_insert(cache, scores[i].hash, scores[i].oncts);
+}
+
+// scores a child from breed_candidate, unless the cache has it. hash goes in
+// as the hash of the child and comes out as that of the repaired child
+inline s32 score_child(Edge *candidate, Node *local_graph, Graph *g, Fitness_Cache *cache,
+                       u64 *hash, Phase_Times *times) {
+    if (!cache->entries) {
+        return optimize_and_score(candidate, local_graph, g->onct_length,
+                                  g->max_solution_length, g->node_count, g->strand_shift);
+    }
+    s32 score;
+    times->cache_lookups++;
+    if (cache_lookup(cache, *hash, &score)) {
+        times->cache_hits++;
+        return score;
+    }
+    score = optimize_and_score(candidate, local_graph, g->onct_length, g->max_solution_length,
+                               g->node_count, g->strand_shift, hash);
+    cache_insert(cache, *hash, score);
+    return score;
+}
+
+//
+// steady state GA
+//
+
+#define STEADY_TOURNAMENT 4  // slots drawn to pick a parent or the one to replace
+#define STEADY_BATCH      64 // children a thread claims at a time
+
+inline void lock_slot(Slot *slot) {
+    while (slot->lock.exchange(1, std::memory_order_acquire)) {
+        while (slot->lock.load(std::memory_order_relaxed)) std::this_thread::yield();
+    }
+}
+
+inline void unlock_slot(Slot *slot) {
+    slot->lock.store(0, std::memory_order_release);
+}
+
+// the best, or the worst, of STEADY_TOURNAMENT random slots
+s32 tournament(Slot *slots, s32 population, Rng *rng, bool best) {
+    s32 winner = rng_next(rng) % population;
+    s32 winner_score = slots[winner].score.load(std::memory_order_relaxed);
+    for (s32 i = 1; i < STEADY_TOURNAMENT; i++) {
+        s32 other = rng_next(rng) % population;
+        s32 score = slots[other].score.load(std::memory_order_relaxed);
+        if (best ? score > winner_score : score < winner_score) {
+            winner = other;
+            winner_score = score;
+        }
+    }
+    return winner;
+}
+
+// the loop of evolve without generations: every thread on its own breeds a
+// child of two tournament winners and puts it in place of a tournament loser
+// that isn't better, until children_left children are made. slots are only
+// locked while a candidate is copied, there is no sort and no barrier. returns
+// the number of children made
+s64 evolve_steady_state(Graph *g, Solve_Params *params, Run_Workspace *workspace,
+                        std::atomic<s32> *stop, s32 threads, s64 children_left) {
+    s32 node_count = g->node_count;
+    s32 population = params->population;
+    s32 candidate_size = node_count * sizeof(Edge);
+    u8 *candidates = workspace->candidates;
+    Score *scores = workspace->scores;
+    Slot *slots = workspace->slots;
+    for (s32 i = 0; i < population; i++) {
+        slots[scores[i].index].lock.store(0);
+        slots[scores[i].index].score.store(scores[i].oncts);
+    }
+
+    std::atomic<s64> claimed(0);
+    std::atomic<s64> made(0);
+    // the loop of one of the threads, breeding into child buffer index
+    auto breed_loop = [&](s32 index) {
+        Rng rng = rng_seed(params->seed ^ ((u64)(index + 1) << 48));
+        Node *local_graph = thread_graph(g);
+        Phase_Times *times = thread_times(workspace, threads);
+        Timeline *timeline = thread_timeline(workspace, threads);
+        Edge *child = (Edge *)(workspace->children + index * candidate_size);
+        s32 children_per_generation = stb_max(1, population - params->parent_count);
+
+        while (!stop->load(std::memory_order_relaxed)) {
+            s64 first = claimed.fetch_add(STEADY_BATCH);
+            if (first >= children_left) break;
+            s64 batch = stb_min((s64)STEADY_BATCH, children_left - first);
+            u64 span = timeline_begin(timeline);
+            for (s64 i = 0; i < batch; i++) {
+                {
+                    TIME_PHASE(times, PHASE_CROSSOVER);
+                    s32 parent_a = tournament(slots, population, &rng, true);
+                    s32 split = node_count;
+                    if (params->breed) split = rng_next(&rng) % node_count;
+                    lock_slot(&slots[parent_a]);
+                    memcpy(child, candidates + parent_a*candidate_size, split * sizeof(Edge));
+                    unlock_slot(&slots[parent_a]);
+                    if (split < node_count) {
+                        s32 parent_b = tournament(slots, population, &rng, true);
+                        lock_slot(&slots[parent_b]);
+                        memcpy(child + split, candidates + parent_b*candidate_size + split*sizeof(Edge),
+                               (node_count - split) * sizeof(Edge));
+                        unlock_slot(&slots[parent_b]);
+                    }
+                    mutate(child, g, local_graph, params->mutations, &rng);
+                }
+
+                s32 score;
+                {
+                    TIME_PHASE(times, PHASE_SCORING);
+                    score = optimize_and_score(child, local_graph, g->onct_length,
+                                               g->max_solution_length, node_count,
+                                               g->strand_shift);
+                }
+
+                {
+                    TIME_PHASE(times, PHASE_SELECTION);
+                    s32 loser = tournament(slots, population, &rng, false);
+                    Slot *slot = &slots[loser];
+                    lock_slot(slot);
+                    if (score >= slot->score.load(std::memory_order_relaxed)) {
+                        memcpy(candidates + loser*candidate_size, child, candidate_size);
+                        slot->score.store(score, std::memory_order_relaxed);
+                    }
+                    unlock_slot(slot);
+                }
+                if (score == g->optimal_score) stop->store(1);
+            }
+            made += batch;
+            timeline_end(timeline, EVENT_BATCH, span, (s32)(first / children_per_generation));
+        }
+    };
+
+    if (params->tasks) {
+        task_parallel_for(0, threads, 1, [&](s64 begin, s64 end) {
+            for (s64 index = begin; index < end; index++) breed_loop((s32)index);
+        });
+    } else {
+#ifdef PARALLEL
+#pragma omp parallel num_threads(threads)
+#endif
+        breed_loop(stb_min(thread_index(), threads-1));
+    }
+
+    // scores in slot order, for evolve to pick the best
+    for (s32 i = 0; i < population; i++) {
+        scores[i].oncts = slots[i].score.load();
+        scores[i].index = i;
+        scores[i].hash = 0;
+    }
+    return made.load();
+}
+
+// a candidate of the first generation: the cheapest edge out of every node,
+// except for node 0 whose edge spreads the starting oligos over the population
+inline void init_candidate(Edge *candidate, s32 candidate_index, Node *local_graph,
+                           s32 node_count) {
+    for (s32 i = 0; i < node_count; i++) {
+        s32 edge_count = local_graph[i].edge_count;
+        if (edge_count) {
+            //s32 chosen_edge = stb_rand() % stb_min(2, edge_count);
+            s32 chosen_edge = 0;
+            if (i == 0) {
+                chosen_edge = candidate_index % edge_count;
+            }
+            candidate[i] = local_graph[i].edges[chosen_edge];
+        } else {
+            candidate[i] = Edge{};
+        }
+    }
+}
+
+// sets candidate candidate_index to a mutated cross of the parents at the start
+// of the population. with hashing returns its hash, from those of the parents
+inline u64 breed_candidate(u8 *candidates, Score *scores, s32 candidate_index,
+                           s32 candidate_size, Graph *g, Node *local_graph,
+                           Solve_Params *params, Rng *rng, bool hashing) {
+    s32 node_count = g->node_count;
+    s32 parent_count = params->parent_count;
+    Edge *candidate = (Edge *)(candidates + candidate_index*candidate_size);
+    u64 hash = 0;
+    if (params->breed) {
+        s32 parent_a_i = candidate_index % parent_count;
+        s32 parent_b_i = rng_next(rng) % parent_count;
+        s32 split = rng_next(rng) % node_count;
+        //s32 split = node_count/2;
+        s32 size_a = split * sizeof(Edge);
+        //s32 size_a = (node_count/2) * sizeof(Edge);
+        s32 size_b = candidate_size - size_a;
+        Edge *parent_a = (Edge *)(candidates + parent_a_i*candidate_size);
+        Edge *parent_b = (Edge *)(candidates + parent_b_i*candidate_size + size_a);
+        Edge *candidate_b = (Edge *)(candidates + candidate_index*candidate_size + size_a);
+        // move the first half of the genes from the first parent
+        memcpy(candidate, parent_a, size_a);
+        // move the second half of the genes from the second parent
+        memcpy(candidate_b, parent_b, size_b);
+
+        // start from the parent the child shares more genes with
+        if (hashing && split >= node_count - split) {
+            hash = scores[parent_a_i].hash;
+            for (s32 i = split; i < node_count; i++) {
+                hash ^= gene_hash(i, parent_a[i]) ^ gene_hash(i, candidate[i]);
+            }
+        } else if (hashing) {
+            Edge *whole_b = (Edge *)(candidates + parent_b_i*candidate_size);
+            hash = scores[parent_b_i].hash;
+            for (s32 i = 0; i < split; i++) {
+                hash ^= gene_hash(i, whole_b[i]) ^ gene_hash(i, candidate[i]);
+            }
+        }
+    } else {
+        s32 parent_i = candidate_index % parent_count;
+        Edge *parent = (Edge *)(candidates + parent_i*candidate_size);
+        memcpy(candidate, parent, candidate_size);
+        if (hashing) hash = scores[parent_i].hash;
+    }
+    mutate(candidate, g, local_graph, params->mutations, rng, hashing ? &hash : 0);
+    return hash;
+}
+
+// items per task of the GA loops with Solve_Params.tasks. children are small
+// pieces because their repair walks differ a lot in length
+#define TASK_GRAIN_CHILDREN 4
+#define TASK_GRAIN_COPIES   64
+
+// one generation of evolve on the task pool, after the selection sort. the
+// same steps as the OpenMP team takes, without the barriers. every piece of
+// children seeds its own stream from where it starts, and pieces are split the
+// same way whichever worker runs them, so the result doesn't depend on timing
+void evolve_tasks(Graph *g, Solve_Params *params, Run_Workspace *workspace,
+                  s32 threads, s32 gen_index) {
+    s32 population = params->population;
+    s32 parent_count = params->parent_count;
+    s32 candidate_size = g->node_count * sizeof(Edge);
+    u8 *candidates = workspace->candidates;
+    u8 *parents = candidates + population * candidate_size;
+    Score *scores = workspace->scores;
+
+    // save the best solutions for breeding and move them to the start
+    task_parallel_for(0, parent_count, TASK_GRAIN_COPIES, [&](s64 begin, s64 end) {
+        Phase_Times *times = thread_times(workspace, threads);
+        Timeline *timeline = thread_timeline(workspace, threads);
+        u64 span = timeline_begin(timeline);
+        TIME_PHASE(times, PHASE_SELECTION);
+        for (s32 parent_i = (s32)begin; parent_i < end; parent_i++) {
+            s32 old_index = scores[parent_i].index;
+            scores[parent_i].index = parent_i;
+            memcpy(parents + parent_i*candidate_size,
+                   candidates + old_index*candidate_size, candidate_size);
+        }
+        timeline_end(timeline, EVENT_PARENTS, span, gen_index);
+    });
+    task_parallel_for(0, parent_count, TASK_GRAIN_COPIES, [&](s64 begin, s64 end) {
+        Phase_Times *times = thread_times(workspace, threads);
+        Timeline *timeline = thread_timeline(workspace, threads);
+        u64 span = timeline_begin(timeline);
+        TIME_PHASE(times, PHASE_SELECTION);
+        memcpy(candidates + begin*candidate_size, parents + begin*candidate_size,
+               (end - begin) * candidate_size);
+        timeline_end(timeline, EVENT_PARENTS_BACK, span, gen_index);
+    });
+
+    task_parallel_for(parent_count, population, TASK_GRAIN_CHILDREN, [&](s64 begin, s64 end) {
+        Rng rng = rng_seed(params->seed ^ ((u64)gen_index << 32) ^ (u64)begin);
+        Node *local_graph = thread_graph(g);
+        Phase_Times *times = thread_times(workspace, threads);
+        Timeline *timeline = thread_timeline(workspace, threads);
+        u64 span = timeline_begin(timeline);
+        for (s32 candidate_index = (s32)begin; candidate_index < end; candidate_index++) {
+            Edge *candidate = (Edge *)(candidates + candidate_index*candidate_size);
+            u64 hash;
+            {
+                TIME_PHASE(times, PHASE_CROSSOVER);
+                hash = breed_candidate(candidates, scores, candidate_index, candidate_size, g,
+                                       local_graph, params, &rng, workspace->cache.entries);
+            }
+
+            TIME_PHASE(times, PHASE_SCORING);
+            scores[candidate_index].oncts = score_child(candidate, local_graph, g,
+                                                        &workspace->cache, &hash, times);
+            scores[candidate_index].index = candidate_index;
+            scores[candidate_index].hash = hash;
+        }
+        timeline_end(timeline, EVENT_CHILDREN, span, gen_index);
+    });
+}
+
+// runs the genetic algorithm on an already built graph. the graph is only
+// read, so several runs can share it. leaves the best candidate and its score
+// in the workspace. stops early when *stop becomes nonzero and sets it when
+// the optimal score is reached
+void evolve(Graph *g, Solve_Params *params, Run_Workspace *workspace,
+            std::atomic<s32> *stop) {
+    u64 start_time = stm_now();
+    s32 node_count = g->node_count;
+    s32 onct_length = g->onct_length;
+    s32 max_solution_length = g->max_solution_length;
+    s32 strand_shift = g->strand_shift;
+
+    //
+    // create population
+    //
+
+    s32 population = params->population;
+    s32 parent_count = params->parent_count;
+    s32 candidate_size = node_count * sizeof(Edge);
+    u8 *candidates = workspace->candidates;
+    u8 *parents = candidates + population * candidate_size;
+
+    Score *scores = workspace->scores;
+    s32 threads = params->threads > 0 ? params->threads : core_count();
+    memset(workspace->thread_times, 0, threads * sizeof(Phase_Times));
+    for (s32 i = 0; i < threads; i++) {
+        workspace->thread_times[i].counting = workspace->counting;
+    }
+
+    // tasks land on any worker, so there is no first touch placement to keep
+    if (params->tasks) {
+        task_parallel_for(0, population, TASK_GRAIN_CHILDREN, [&](s64 begin, s64 end) {
+            Node *local_graph = thread_graph(g);
+            Phase_Times *times = thread_times(workspace, threads);
+            Timeline *timeline = thread_timeline(workspace, threads);
+            u64 span = timeline_begin(timeline);
+            for (s32 candidate_index = (s32)begin; candidate_index < end; candidate_index++) {
+                TIME_PHASE(times, PHASE_INIT);
+                Edge *candidate = (Edge *)(candidates + candidate_index*candidate_size);
+                if (candidate_index < parent_count) {
+                    memset(parents + candidate_index*candidate_size, 0, candidate_size);
+                }
+                init_candidate(candidate, candidate_index, local_graph, node_count);
+                scores[candidate_index].oncts = optimize_and_score(candidate, local_graph,
+                                                                   onct_length,
+                                                                   max_solution_length,
+                                                                   node_count, strand_shift);
+                scores[candidate_index].index = candidate_index;
+                scores[candidate_index].hash = workspace->cache.entries ?
+                                               candidate_hash(candidate, node_count) : 0;
+            }
+            timeline_end(timeline, EVENT_INIT, span, -1);
+        });
+    } else
+    // the population is split between the threads the same way as in every
+    // generation below (static schedule, same team size), so each candidate
+    // is first touched by the thread that will keep rewriting it and its pages
+    // end up on that thread's NUMA node
+#ifdef PARALLEL
+#pragma omp parallel num_threads(threads)
+#endif
+    {
+        Node *local_graph = thread_graph(g);
+        Phase_Times *times = thread_times(workspace, threads);
+        Timeline *timeline = thread_timeline(workspace, threads);
+        for (s32 part = 0; part < 2; part++) {
+            s32 part_start = part ? parent_count : 0;
+            s32 part_end = part ? population : parent_count;
+            u64 span = timeline_begin(timeline);
+#ifdef PARALLEL
+#pragma omp for schedule(static) nowait
+#endif
+            for (s32 candidate_index = part_start;
+                 candidate_index < part_end;
+                 candidate_index++)
+            {
+                TIME_PHASE(times, PHASE_INIT);
+                Edge *candidate = (Edge *)(candidates + candidate_index*candidate_size);
+                if (part == 0) {
+                    memset(parents + candidate_index*candidate_size, 0, candidate_size);
+                }
+                init_candidate(candidate, candidate_index, local_graph, node_count);
+                Score s;
+                s.oncts = optimize_and_score(candidate, local_graph, onct_length,
+                                             max_solution_length, node_count, strand_shift);
+                s.index = candidate_index;
+                s.hash = workspace->cache.entries ? candidate_hash(candidate, node_count) : 0;
+                scores[candidate_index] = s;
+            }
+            timeline_end(timeline, EVENT_INIT, span, -1);
+            timeline_barrier(timeline, -1);
+        }
+    }
+
+    // the population above still placed the pages, the checkpoint only
+    // overwrites it
+    s32 first_generation = 0;
+    if (params->checkpoint_path && params->resume) {
+        first_generation = read_checkpoint(workspace, params, node_count);
+    }
+    workspace->resumed_from = first_generation;
+    std::thread checkpoint_writer;
+    std::atomic<s32> checkpoint_writing(0);
+    s32 checkpoint_every = stb_max(1, params->checkpoint_every);
+
+    //
+    // evolve
+    //
+
+    s32 optimal_score = g->optimal_score;
+
+    s32 generations = params->generations;
+    s32 gen_index = first_generation;
+    if (params->steady_state) {
+        // the same number of children as the generations would make
+        s32 children_per_generation = stb_max(1, population - parent_count);
+        s64 children = evolve_steady_state(g, params, workspace, stop, threads,
+                                           (s64)(generations - first_generation) *
+                                           children_per_generation);
+        gen_index += (s32)(children / children_per_generation);
+        generations = 0;
+    }
+    for (; gen_index < generations; gen_index++)
+    {
+        {
+            // with tasks the run may be on any worker, the others may be using
+            // the first slot
+            TIME_PHASE(params->tasks ? thread_times(workspace, threads) :
+                                       &workspace->thread_times[0], PHASE_SELECTION);
+            Timeline *timeline = params->tasks ? thread_timeline(workspace, threads) :
+                                                 workspace->timelines;
+            u64 span = timeline_begin(timeline);
+            qsort(scores, population, sizeof(Score), score_cmp_desc);
+            timeline_end(timeline, EVENT_SELECTION, span, gen_index);
+        }
+        if (workspace->trace) {
+            trace_generation(workspace, gen_index, population, node_count, start_time);
+        }
+        if (params->checkpoint_path && gen_index > first_generation &&
+            gen_index % checkpoint_every == 0) {
+            start_checkpoint(workspace, params, node_count, gen_index,
+                             &checkpoint_writer, &checkpoint_writing);
+        }
+
+        if (scores[0].oncts == optimal_score) {
+            stop->store(1);
+            break;
+        }
+        if (stop->load(std::memory_order_relaxed)) break;
+
+        if (workspace->cache.entries) {
+            TIME_PHASE(params->tasks ? thread_times(workspace, threads) :
+                                       &workspace->thread_times[0], PHASE_SELECTION);
+            reset_cache(&workspace->cache, scores, parent_count);
+        }
+
+        if (params->tasks) {
+            evolve_tasks(g, params, workspace, threads, gen_index);
+        } else
+#ifdef PARALLEL
+#pragma omp parallel num_threads(threads)
+#endif
+        {
+            // stb_rand is not thread safe, so every thread gets its own stream
+            Rng rng = rng_seed(params->seed ^ ((u64)gen_index << 32) ^ thread_index());
+            Node *local_graph = thread_graph(g);
+            Phase_Times *times = thread_times(workspace, threads);
+            Timeline *timeline = thread_timeline(workspace, threads);
+
+            // save the best solutions for breeding
+            u64 span = timeline_begin(timeline);
+#ifdef PARALLEL
+#pragma omp for schedule(static) nowait
+#endif
+            for (s32 parent_i = 0; parent_i < parent_count; parent_i++) {
+                TIME_PHASE(times, PHASE_SELECTION);
+                Edge *parent_slot = (Edge *)(parents + parent_i*candidate_size);
+                s32 old_index = scores[parent_i].index;
+                scores[parent_i].index = parent_i;
+                Edge *parent = (Edge *)(candidates + old_index*candidate_size);
+                memcpy(parent_slot, parent, candidate_size);
+            }
+            timeline_end(timeline, EVENT_PARENTS, span, gen_index);
+            timeline_barrier(timeline, gen_index);
+
+            // move them to the beggining of the population, each thread its
+            // own part
+            span = timeline_begin(timeline);
+#ifdef PARALLEL
+#pragma omp for schedule(static) nowait
+#endif
+            for (s32 parent_i = 0; parent_i < parent_count; parent_i++) {
+                TIME_PHASE(times, PHASE_SELECTION);
+                memcpy(candidates + parent_i*candidate_size,
+                       parents + parent_i*candidate_size, candidate_size);
+            }
+            timeline_end(timeline, EVENT_PARENTS_BACK, span, gen_index);
+            timeline_barrier(timeline, gen_index);
+
+            // set the rest of the population to modified versions of parents
+            span = timeline_begin(timeline);
+#ifdef PARALLEL
+#pragma omp for schedule(static) nowait
+#endif
+            for (s32 candidate_index = parent_count;
+                    candidate_index < population;
+                    candidate_index++)
+            {
+                Edge *candidate = (Edge *)(candidates + candidate_index*candidate_size);
+                u64 hash;
+                {
+                    TIME_PHASE(times, PHASE_CROSSOVER);
+                    hash = breed_candidate(candidates, scores, candidate_index, candidate_size,
+                                           g, local_graph, params, &rng,
+                                           workspace->cache.entries);
+                }
+
+                TIME_PHASE(times, PHASE_SCORING);
+                s32 score = score_child(candidate, local_graph, g, &workspace->cache, &hash,
+                                        times);
+                scores[candidate_index].oncts = score;
+                scores[candidate_index].index = candidate_index;
+                scores[candidate_index].hash = hash;
+            }
+            timeline_end(timeline, EVENT_CHILDREN, span, gen_index);
+            timeline_barrier(timeline, gen_index);
+        }
+    }
+
+    s32 best_i = 0;
+    for (s32 i = 1; i < population; i++) {
+        if (scores[i].oncts > scores[best_i].oncts) {
+            best_i = i;
+        }
+    }
+    //qsort(scores, population, sizeof(Score), score_cmp_desc);
+    s32 best_score = scores[best_i].oncts;
+    s32 best_index = scores[best_i].index;
+
+    memcpy(workspace->best,
+           candidates + best_index*candidate_size,
+           candidate_size);
+    workspace->best_score = best_score;
+    workspace->generations = gen_index;
+
+    // a finished run has nothing to resume
+    if (checkpoint_writer.joinable()) checkpoint_writer.join();
+    if (params->checkpoint_path) remove(params->checkpoint_path);
+}
+
+char complement(char c) {
+    switch (c) {
+    case 'A': return 'T';
+    case 'C': return 'G';
+    case 'G': return 'C';
+    case 'T': return 'A';
+    }
+    return c;
+}
+
+// a spectrum with both strands of every oligo, oligo i forward at 2i and
+// reverse complemented at 2i+1, to build the graph of a double stranded solve
+Spectrum oriented_spectrum(Spectrum *spectrum, Arena *arena) {
+    s32 onct_length = spectrum->onct_length;
+    Spectrum result = {};
+    result.onct_length = onct_length;
+    result.stride = onct_length;
+    result.count = 2 * spectrum->count;
+    result.data = (char *)arena_push(arena, (size_t)result.count * onct_length);
+    for (s32 i = 0; i < spectrum->count; i++) {
+        char *oligo = spectrum_oligo(spectrum, i);
+        char *forward = spectrum_oligo(&result, 2*i);
+        char *reverse = spectrum_oligo(&result, 2*i + 1);
+        memcpy(forward, oligo, onct_length);
+        for (s32 j = 0; j < onct_length; j++) {
+            reverse[j] = complement(oligo[onct_length-1 - j]);
+        }
+    }
+    return result;
+}
+
+inline size_t sequence_capacity(Graph *g) {
+    return stb_max(g->max_solution_length, g->onct_length) + 1;
+}
+
+// walks the candidate the same way optimize_and_score does and stores the
+// oligos on the path and the sequence they spell
+void fill_result(Arena *arena, Spectrum *spectrum, Graph *g,
+                 Edge *candidate, Solve_Result *result) {
+    s32 onct_length = g->onct_length;
+    s32 max_solution_length = g->max_solution_length;
+    s32 strand_shift = g->strand_shift;
+    s32 *path = (s32 *)arena_push(arena, g->node_count * sizeof(s32));
+    u8 *strands = strand_shift ? (u8 *)arena_push(arena, g->node_count) : 0;
+    char *sequence = (char *)arena_push(arena, sequence_capacity(g));
+
+    s32 path_length = 0;
+    s32 sequence_length = 0;
+    s32 total_length = onct_length;
+    s32 current = candidate[0].next;
+    u8 visited[MAX_NODES] = {};
+    s32 last_cost = onct_length;
+    while (candidate[current].cost) {
+        if (visited[visit_slot(current, strand_shift)]) break;
+        visited[visit_slot(current, strand_shift)] = true;
+
+        if (strands) strands[path_length] = (current-1) & 1;
+        path[path_length++] = (current-1) >> strand_shift;
+        memcpy(sequence + sequence_length,
+               spectrum_oligo(spectrum, current-1) + (onct_length-last_cost),
+               last_cost);
+        sequence_length += last_cost;
+        if (candidate[current].cost + total_length > max_solution_length) {
+            break;
+        }
+        total_length += candidate[current].cost;
+        last_cost = candidate[current].cost;
+        current = candidate[current].next;
+    }
+    sequence[sequence_length] = 0;
+
+    result->path = path;
+    result->strands = strands;
+    result->path_length = path_length;
+    result->sequence = sequence;
+    result->sequence_length = sequence_length;
+}
+
+// parameter sets the portfolio cycles through, relative to the base params
+Solve_Params portfolio_params(s32 run_index, Solve_Params *base) {
+    Solve_Params params = *base;
+    params.seed = base->seed + run_index;
+    switch (run_index % 6) {
+        case 0: break;
+        case 1: params.mutations = stb_max(1, params.mutations/2); break;
+        case 2: params.mutations *= 2; break;
+        case 3: {
+            params.population /= 2;
+            params.parent_count /= 2;
+            params.generations *= 2;
+        } break;
+        // crossover on if the base has it off and the other way around
+        case 4: params.breed = !base->breed; break;
+        case 5: params.steady_state = !base->steady_state; break;
+    }
+    return params;
+}
+
+//
+// de Bruijn fast path
+//
+
+// without positive errors every oligo is part of the sequence, which is then an
+// Eulerian path through the de Bruijn graph whose nodes are the (k-1)-mers of
+// the spectrum and whose edges are the oligos. a missing oligo breaks the path,
+// leaving a node with an edge too few out and one with an edge too few in.
+// these are joined by gap edges over their longest overlap, at most
+// DE_BRUIJN_MAX_GAPS of them. when that doesn't give one path that fits in the
+// solution, the genetic algorithm takes over
+#define DE_BRUIJN_MAX_GAPS 64
+
+struct De_Bruijn {
+    s32 key_length; // k-1
+    char **keys;    // the (k-1)-mer of every node, points into the spectrum
+    s32 node_count;
+    s32 *table;     // open addressing, node index+1 per slot
+    u32 table_mask;
+
+    // edges are the oligos, in spectrum order, followed by the gaps
+    s32 *from;
+    s32 *to;
+    s32 oligo_count;
+    s32 edge_count;
+    s32 gap_overlap[DE_BRUIJN_MAX_GAPS]; // of the keys the gap joins
+};
+
+u32 de_bruijn_table_size(s32 count) {
+    u32 size = 16;
+    while (size < 4 * (u32)count) size *= 2;
+    return size;
+}
+
+size_t de_bruijn_size(s32 count, s32 original_oncts, s32 onct_length) {
+    s32 node_capacity = 2 * count;
+    s32 edge_capacity = count + DE_BRUIJN_MAX_GAPS;
+    return align_up(node_capacity * sizeof(char *), ARENA_ALIGNMENT) +
+           align_up(de_bruijn_table_size(count) * sizeof(s32), ARENA_ALIGNMENT) +
+           2 * align_up(edge_capacity * sizeof(s32), ARENA_ALIGNMENT) +       // from, to
+           3 * align_up(node_capacity * sizeof(s32), ARENA_ALIGNMENT) +       // balance, root, next
+           align_up((node_capacity + 1) * sizeof(s32), ARENA_ALIGNMENT) +     // first
+           align_up(edge_capacity * sizeof(s32), ARENA_ALIGNMENT) +           // adjacent
+           2 * align_up((edge_capacity + 1) * sizeof(s32), ARENA_ALIGNMENT) + // walk stacks
+           align_up(edge_capacity * sizeof(s32), ARENA_ALIGNMENT) +           // walk
+           align_up(count * sizeof(s32), ARENA_ALIGNMENT) +
+           align_up(original_oncts + onct_length, ARENA_ALIGNMENT) +
+           align_up(sizeof(Phase_Counters), ARENA_ALIGNMENT);
+}
+
+u64 de_bruijn_hash(char *key, s32 length) {
+    u64 hash = 14695981039346656037ull;
+    for (s32 i = 0; i < length; i++) {
+        hash = (hash ^ (u8)key[i]) * 1099511628211ull;
+    }
+    return hash ^ (hash >> 32);
+}
+
+s32 de_bruijn_node(De_Bruijn *db, char *key) {
+    u32 slot = (u32)de_bruijn_hash(key, db->key_length) & db->table_mask;
+    while (db->table[slot]) {
+        s32 node = db->table[slot] - 1;
+        if (memcmp(db->keys[node], key, db->key_length) == 0) return node;
+        slot = (slot + 1) & db->table_mask;
+    }
+    db->keys[db->node_count] = key;
+    db->table[slot] = ++db->node_count;
+    return db->node_count - 1;
+}
+
+s32 find_root(s32 *root, s32 node) {
+    while (root[node] != node) {
+        root[node] = root[root[node]];
+        node = root[node];
+    }
+    return node;
+}
+
+// pairs the nodes missing an outgoing edge with the ones missing an incoming
+// edge, longest overlap first. on a tie the pair that joins two pieces of the
+// graph wins, so a piece doesn't close on itself. leaves one start and one end
+bool fill_gaps(De_Bruijn *db, s32 *balance, s32 *root) {
+    s32 sources[DE_BRUIJN_MAX_GAPS+1];
+    s32 sinks[DE_BRUIJN_MAX_GAPS+1];
+    s32 source_count = 0;
+    s32 sink_count = 0;
+    for (s32 node = 0; node < db->node_count; node++) {
+        for (s32 i = 0; i < balance[node]; i++) {
+            if (source_count > DE_BRUIJN_MAX_GAPS) return false;
+            sources[source_count++] = node;
+        }
+        for (s32 i = 0; i < -balance[node]; i++) {
+            if (sink_count > DE_BRUIJN_MAX_GAPS) return false;
+            sinks[sink_count++] = node;
+        }
+    }
+
+    while (sink_count > 1) {
+        s32 best_sink = 0;
+        s32 best_source = 0;
+        s32 best_overlap = 0;
+        s32 best_rank = -1;
+        for (s32 sink_i = 0; sink_i < sink_count; sink_i++) {
+            s32 sink_root = find_root(root, sinks[sink_i]);
+            for (s32 source_i = 0; source_i < source_count; source_i++) {
+                s32 overlap = get_overlap(db->keys[sinks[sink_i]], db->keys[sources[source_i]],
+                                          db->key_length);
+                s32 rank = 2*overlap + (find_root(root, sources[source_i]) != sink_root);
+                if (rank > best_rank) {
+                    best_sink = sink_i;
+                    best_source = source_i;
+                    best_overlap = overlap;
+                    best_rank = rank;
+                }
+            }
+        }
+
+        s32 from = sinks[best_sink];
+        s32 to = sources[best_source];
+        s32 edge = db->edge_count++;
+        db->from[edge] = from;
+        db->to[edge] = to;
+        db->gap_overlap[edge - db->oligo_count] = best_overlap;
+        sinks[best_sink] = sinks[--sink_count];
+        sources[best_source] = sources[--source_count];
+        root[find_root(root, from)] = find_root(root, to);
+        balance[from]++;
+        balance[to]--;
+    }
+    return true;
+}
+
+// solves a spectrum without positive errors as an Eulerian path, false when it
+// has to go to the genetic algorithm
+bool solve_de_bruijn(Arena *arena, Spectrum *spectrum, s32 original_oncts,
+                     Phase_Times *times, Solve_Result *result) {
+    TIME_PHASE(times, PHASE_DE_BRUIJN);
+    s32 count = spectrum->count;
+    s32 onct_length = spectrum->onct_length;
+    if (onct_length < 2 || count > original_oncts) return false;
+    if (!arena_begin(arena, de_bruijn_size(count, original_oncts, onct_length))) return false;
+
+    De_Bruijn db = {};
+    db.key_length = onct_length - 1;
+    db.keys = (char **)arena_push(arena, 2 * count * sizeof(char *));
+    u32 table_size = de_bruijn_table_size(count);
+    db.table = (s32 *)arena_push(arena, table_size * sizeof(s32));
+    memset(db.table, 0, table_size * sizeof(s32));
+    db.table_mask = table_size - 1;
+    db.from = (s32 *)arena_push(arena, (count + DE_BRUIJN_MAX_GAPS) * sizeof(s32));
+    db.to = (s32 *)arena_push(arena, (count + DE_BRUIJN_MAX_GAPS) * sizeof(s32));
+    db.oligo_count = count;
+    db.edge_count = count;
+    for (s32 i = 0; i < count; i++) {
+        char *oligo = spectrum_oligo(spectrum, i);
+        db.from[i] = de_bruijn_node(&db, oligo);
+        db.to[i] = de_bruijn_node(&db, oligo + 1);
+    }
+
+    s32 node_count = db.node_count;
+    s32 *balance = (s32 *)arena_push(arena, node_count * sizeof(s32));
+    s32 *root = (s32 *)arena_push(arena, node_count * sizeof(s32));
+    memset(balance, 0, node_count * sizeof(s32));
+    for (s32 node = 0; node < node_count; node++) root[node] = node;
+    for (s32 i = 0; i < count; i++) {
+        balance[db.from[i]]++;
+        balance[db.to[i]]--;
+        root[find_root(root, db.from[i])] = find_root(root, db.to[i]);
+    }
+    if (!fill_gaps(&db, balance, root)) return false;
+    s32 start = db.from[0];
+    for (s32 node = 0; node < node_count; node++) {
+        if (find_root(root, node) != find_root(root, start)) return false;
+        if (balance[node] > 0) start = node;
+    }
+
+    // outgoing edges of every node
+    s32 edge_count = db.edge_count;
+    s32 *first = (s32 *)arena_push(arena, (node_count + 1) * sizeof(s32));
+    s32 *next = (s32 *)arena_push(arena, node_count * sizeof(s32));
+    s32 *adjacent = (s32 *)arena_push(arena, edge_count * sizeof(s32));
+    memset(first, 0, (node_count + 1) * sizeof(s32));
+    for (s32 e = 0; e < edge_count; e++) first[db.from[e] + 1]++;
+    for (s32 node = 0; node < node_count; node++) {
+        first[node + 1] += first[node];
+        next[node] = first[node];
+    }
+    for (s32 e = 0; e < edge_count; e++) adjacent[next[db.from[e]]++] = e;
+    for (s32 node = 0; node < node_count; node++) next[node] = first[node];
+
+    // Hierholzer, the walk comes out backwards
+    s32 *node_stack = (s32 *)arena_push(arena, (edge_count + 1) * sizeof(s32));
+    s32 *edge_stack = (s32 *)arena_push(arena, (edge_count + 1) * sizeof(s32));
+    s32 *walk = (s32 *)arena_push(arena, edge_count * sizeof(s32));
+    s32 walk_length = 0;
+    s32 top = 0;
+    node_stack[0] = start;
+    edge_stack[0] = -1;
+    while (top >= 0) {
+        s32 node = node_stack[top];
+        if (next[node] < first[node + 1]) {
+            s32 e = adjacent[next[node]++];
+            top++;
+            node_stack[top] = db.to[e];
+            edge_stack[top] = e;
+        } else {
+            if (edge_stack[top] >= 0) walk[walk_length++] = edge_stack[top];
+            top--;
+        }
+    }
+    if (walk_length != edge_count) return false;
+    for (s32 i = 0; i < walk_length/2; i++) {
+        s32 t = walk[i]; walk[i] = walk[walk_length-1 - i]; walk[walk_length-1 - i] = t;
+    }
+
+    // a closed walk can start anywhere, so start it after a gap and drop that
+    s32 walk_start = 0;
+    if (db.from[walk[0]] == db.to[walk[walk_length-1]]) {
+        for (s32 i = 0; i < walk_length; i++) {
+            if (walk[i] >= count) {
+                walk_start = i + 1;
+                walk_length--;
+                break;
+            }
+        }
+    }
+
+    s32 max_solution_length = original_oncts + onct_length - 1;
+    s32 sequence_length = db.key_length;
+    for (s32 i = 0; i < walk_length; i++) {
+        s32 e = walk[(walk_start + i) % edge_count];
+        sequence_length += e < count ? 1 : db.key_length - db.gap_overlap[e - count];
+    }
+    if (sequence_length > max_solution_length) return false;
+
+    s32 *path = (s32 *)arena_push(arena, count * sizeof(s32));
+    char *sequence = (char *)arena_push(arena, max_solution_length + 1);
+    s32 path_length = 0;
+    char *cursor = sequence;
+    memcpy(cursor, db.keys[db.from[walk[walk_start % edge_count]]], db.key_length);
+    cursor += db.key_length;
+    for (s32 i = 0; i < walk_length; i++) {
+        s32 e = walk[(walk_start + i) % edge_count];
+        if (e < count) {
+            path[path_length++] = e;
+            *cursor++ = db.keys[db.to[e]][db.key_length - 1];
+        } else {
+            s32 overlap = db.gap_overlap[e - count];
+            memcpy(cursor, db.keys[db.to[e]] + overlap, db.key_length - overlap);
+            cursor += db.key_length - overlap;
+        }
+    }
+    *cursor = 0;
+
+    result->path = path;
+    result->path_length = path_length;
+    result->sequence = sequence;
+    result->sequence_length = sequence_length;
+    result->score = path_length;
+    result->optimal_score = count;
+    result->percent_score = 100;
+    result->de_bruijn = true;
+    return true;
+}
+
+inline bool use_cache(Solve_Params *params) {
+#ifdef FITNESS_CACHE
+    // the steady state loop has no generations to cache
+    return !params->steady_state;
+#else
+    return false;
+#endif
+}
+
+bool begin_solve(Solver_Context *context, Spectrum *spectrum, s32 original_oncts,
+                 s32 runs, Solve_Params *params_in) {
+    Pending_Solve *pending = &context->pending;
+    *pending = Pending_Solve{};
+    pending->base = *params_in;
+    Solve_Params *base = &pending->base;
+    u64 start_time = stm_now();
+    pending->start_time = start_time;
+    Solve_Result *result = &pending->result;
+    Arena *arena = &context->arena;
+    s32 grow_count = arena->grow_count;
+    pending->grow_count = grow_count;
+    bool counting = arena->flags & CONTEXT_COUNTERS;
+    pending->counting = counting;
+    // the fast path and the graph are timed on the calling thread
+    Phase_Times build_times = {};
+    build_times.counting = counting;
+
+#ifdef DE_BRUIJN
+    // the de Bruijn walk only follows one strand
+    if (spectrum->count > 0 && !base->double_stranded) {
+        if (solve_de_bruijn(arena, spectrum, original_oncts, &build_times, result)) {
+            result->memory_size = arena->capacity;
+            result->memory_grown = arena->grow_count != grow_count;
+            result->huge_pages = arena->huge_pages;
+            result->huge_page_bytes = arena_huge_page_bytes(arena);
+            result->elapsed_ms = stm_ms(stm_since(start_time));
+            for (s32 phase = 0; phase < PHASE_COUNT; phase++) {
+                result->phase_ms[phase] = stm_ms(build_times.ticks[phase]);
+            }
+            if (counting) {
+                result->thread_counters = (Phase_Counters *)arena_push(arena,
+                                                                       sizeof(Phase_Counters));
+                memcpy(result->thread_counters->values, build_times.counters,
+                       sizeof(result->thread_counters->values));
+                result->counters = *result->thread_counters;
+                result->thread_count = 1;
+                result->counters_available = perf_open()->available;
+            }
+            pending->active = true;
+            pending->done = true;
+            return true;
+        }
+    }
+#endif
+    s32 strand_shift = base->double_stranded ? 1 : 0;
+    if (spectrum->count == 0 || spectrum->count << strand_shift >= MAX_NODES) {
+        fprintf(stderr, "%d oligos, the solver takes 1 to %d%s\n",
+                spectrum->count, (MAX_NODES-1) >> strand_shift,
+                strand_shift ? " double stranded" : "");
+        return false;
+    }
+    runs = stb_max(runs, 1);
+    s32 threads = base->threads > 0 ? base->threads : core_count();
+    s32 outer_threads = stb_min(runs, threads);
+    // the runs of a task pool solve share all of its workers, and need per
+    // thread state for each of them
+    s32 run_threads = stb_max(1, threads / outer_threads);
+    if (base->tasks) {
+        threads = task_worker_count();
+        run_threads = threads;
+    }
+
+    // everything the solve needs comes from the arena, so size it first
+    s32 node_count = (spectrum->count << strand_shift) + 1;
+    size_t candidate_size = node_count * sizeof(Edge);
+    size_t memory_size = align_up(graph_size(node_count), ARENA_ALIGNMENT) +
+                         optimize_graph_size(node_count) +
+                         align_up(runs * sizeof(Solve_Params), ARENA_ALIGNMENT) +
+                         align_up(runs * sizeof(Run_Workspace), ARENA_ALIGNMENT);
+    for (s32 run_i = 0; run_i < runs; run_i++) {
+        Solve_Params params = portfolio_params(run_i, base);
+        size_t population = params.population + params.parent_count;
+        memory_size += align_up(run_threads * sizeof(Phase_Times), ARENA_ALIGNMENT) +
+                       align_up(population * candidate_size, ARENA_ALIGNMENT) +
+                       align_up(params.population * sizeof(Score), ARENA_ALIGNMENT) +
+                       (params.trace_path ? align_up((params.generations + 1) * sizeof(Trace_Row),
+                                                     ARENA_ALIGNMENT) : 0) +
+                       (params.timeline_path ? align_up(run_threads * sizeof(Timeline), ARENA_ALIGNMENT) +
+                                               run_threads * align_up(TIMELINE_CAPACITY *
+                                                                      sizeof(Timeline_Event),
+                                                                      ARENA_ALIGNMENT) : 0) +
+                       (use_cache(&params) ? align_up(fitness_cache_capacity(params.population) *
+                                                      sizeof(u64), ARENA_ALIGNMENT) : 0) +
+                       (params.steady_state ? align_up(params.population * sizeof(Slot),
+                                                       ARENA_ALIGNMENT) +
+                                              align_up(run_threads * candidate_size,
+                                                       ARENA_ALIGNMENT) : 0) +
+                       (params.checkpoint_path ? align_up(checkpoint_size(params.population,
+                                                                          node_count),
+                                                          ARENA_ALIGNMENT) + 1024 : 0) +
+                       align_up(candidate_size, ARENA_ALIGNMENT);
+    }
+    bool replicate = (context->arena.flags & CONTEXT_NUMA) && numa_node_count() > 1;
+    if (replicate) {
+        memory_size += (numa_node_count() - 1) *
+                       align_up(graph_size(node_count) + 4096, ARENA_ALIGNMENT);
+    }
+    if (counting) {
+        memory_size += align_up(runs * run_threads * sizeof(Phase_Counters), ARENA_ALIGNMENT);
+    }
+    if (strand_shift) {
+        memory_size += align_up((size_t)(node_count-1) * spectrum->onct_length, ARENA_ALIGNMENT) +
+                       align_up(node_count, ARENA_ALIGNMENT);
+    }
+    memory_size += align_up(node_count * sizeof(s32), ARENA_ALIGNMENT) +
+                   align_up(stb_max(original_oncts + 2*spectrum->onct_length, 1),
+                            ARENA_ALIGNMENT);
+
+    if (!arena_begin(arena, memory_size)) {
+        fprintf(stderr, "can't allocate %zu bytes\n", memory_size);
+        return false;
+    }
+
+    if (strand_shift) pending->oriented = oriented_spectrum(spectrum, arena);
+    pending->graph_spectrum = strand_shift ? &pending->oriented : spectrum;
+    pending->graph = build_graph(pending->graph_spectrum, original_oncts, arena, &build_times,
+                                 strand_shift, base->tasks);
+    Graph *graph = &pending->graph;
+    if (replicate) replicate_graph(graph, arena, threads);
+
+    u32 hash = base->checkpoint_path ? graph_hash(graph) : 0;
+    Solve_Params *params = (Solve_Params *)arena_push(arena, runs * sizeof(Solve_Params));
+    Run_Workspace *workspaces = (Run_Workspace *)arena_push(arena, runs * sizeof(Run_Workspace));
+    for (s32 run_i = 0; run_i < runs; run_i++) {
+        params[run_i] = portfolio_params(run_i, base);
+        params[run_i].threads = run_threads;
+
+        Run_Workspace *workspace = &workspaces[run_i];
+        *workspace = Run_Workspace{};
+        workspace->counting = counting;
+        s32 population = params[run_i].population + params[run_i].parent_count;
+        workspace->candidates = (u8 *)arena_push(arena, population * candidate_size);
+        workspace->scores = (Score *)arena_push(arena, params[run_i].population * sizeof(Score));
+        workspace->best = (Edge *)arena_push(arena, candidate_size);
+        workspace->thread_times = (Phase_Times *)arena_push(arena, params[run_i].threads *
+                                                                   sizeof(Phase_Times));
+        if (params[run_i].trace_path) {
+            workspace->trace = (Trace_Row *)arena_push(arena, (params[run_i].generations + 1) *
+                                                              sizeof(Trace_Row));
+        }
+        if (use_cache(&params[run_i])) {
+            u32 capacity = fitness_cache_capacity(params[run_i].population);
+            workspace->cache.entries = (std::atomic<u64> *)arena_push(arena, capacity *
+                                                                              sizeof(u64));
+            workspace->cache.mask = capacity - 1;
+        }
+        if (params[run_i].steady_state) {
+            workspace->slots = (Slot *)arena_push(arena, params[run_i].population * sizeof(Slot));
+            workspace->children = (u8 *)arena_push(arena, params[run_i].threads * candidate_size);
+        }
+        // every run of a portfolio has a checkpoint of its own, path.N
+        if (params[run_i].checkpoint_path) {
+            if (runs > 1) {
+                char *path = (char *)arena_push(arena, 1024);
+                stb_snprintf(path, 1024, "%s.%d", base->checkpoint_path, run_i);
+                params[run_i].checkpoint_path = path;
+            }
+            workspace->checkpoint_size = checkpoint_size(params[run_i].population, node_count);
+            workspace->checkpoint = (u8 *)arena_push(arena, workspace->checkpoint_size);
+            workspace->graph_hash = hash;
+        }
+        if (params[run_i].timeline_path) {
+            workspace->timelines = (Timeline *)arena_push(arena, run_threads * sizeof(Timeline));
+            for (s32 i = 0; i < run_threads; i++) {
+                workspace->timelines[i].events =
+                    (Timeline_Event *)arena_push(arena, TIMELINE_CAPACITY * sizeof(Timeline_Event));
+                workspace->timelines[i].count = 0;
+            }
+        }
+    }
+
+    pending->active = true;
+    pending->build_times = build_times;
+    pending->runs = runs;
+    pending->outer_threads = outer_threads;
+    pending->params = params;
+    pending->workspaces = workspaces;
+    pending->build_ms = stm_ms(stm_since(start_time));
+    return true;
+}
+
+bool end_solve(Solver_Context *context, Solve_Result *result) {
+    Pending_Solve *pending = &context->pending;
+    if (!pending->active) return false;
+    pending->active = false;
+    if (pending->done) {
+        *result = pending->result;
+        return true;
+    }
+    u64 start_time = stm_now();
+    *result = Solve_Result{};
+    Arena *arena = &context->arena;
+    Solve_Params *base = &pending->base;
+    Graph graph = pending->graph;
+    Solve_Params *params = pending->params;
+    Run_Workspace *workspaces = pending->workspaces;
+    s32 runs = pending->runs;
+    s32 outer_threads = pending->outer_threads;
+    bool counting = pending->counting;
+    Phase_Times build_times = pending->build_times;
+
+    std::atomic<s32> stop(0);
+    if (base->tasks) {
+        task_parallel_for(0, runs, 1, [&](s64 begin, s64 end) {
+            for (s64 run_i = begin; run_i < end; run_i++) {
+                evolve(&graph, &params[run_i], &workspaces[run_i], &stop);
+            }
+        });
+    } else {
+#ifdef PARALLEL
+#pragma omp parallel for schedule(dynamic, 1) num_threads(outer_threads) if(outer_threads > 1)
+#endif
+        for (s32 run_i = 0; run_i < runs; run_i++) {
+            evolve(&graph, &params[run_i], &workspaces[run_i], &stop);
+        }
+    }
+
+    s32 best_run = 0;
+    for (s32 run_i = 1; run_i < runs; run_i++) {
+        if (workspaces[run_i].best_score > workspaces[best_run].best_score) {
+            best_run = run_i;
+        }
+    }
+    Run_Workspace *best = &workspaces[best_run];
+    fill_result(arena, pending->graph_spectrum, &graph, best->best, result);
+    result->score = best->best_score;
+    result->optimal_score = graph.optimal_score;
+    result->percent_score = 100*(double)best->best_score / (double)graph.optimal_score;
+    result->generations = best->generations;
+    result->resumed_from = best->resumed_from;
+    result->memory_size = arena->capacity;
+    result->memory_grown = arena->grow_count != pending->grow_count;
+    result->huge_pages = arena->huge_pages;
+    result->huge_page_bytes = arena_huge_page_bytes(arena);
+    // the wait between the two halves doesn't count
+    result->elapsed_ms = pending->build_ms + stm_ms(stm_since(start_time));
+
+    for (s32 phase = 0; phase < PHASE_COUNT; phase++) {
+        u64 ticks = build_times.ticks[phase];
+        for (s32 run_i = 0; run_i < runs; run_i++) {
+            for (s32 i = 0; i < params[run_i].threads; i++) {
+                ticks += workspaces[run_i].thread_times[i].ticks[phase];
+            }
+        }
+        result->phase_ms[phase] = stm_ms(ticks);
+    }
+    for (s32 run_i = 0; run_i < runs; run_i++) {
+        for (s32 i = 0; i < params[run_i].threads; i++) {
+            result->cache_lookups += workspaces[run_i].thread_times[i].cache_lookups;
+            result->cache_hits += workspaces[run_i].thread_times[i].cache_hits;
+        }
+    }
+
+    // counters per thread of every run, the graph is built by the first
+    if (counting) {
+        s32 thread_count = 0;
+        for (s32 run_i = 0; run_i < runs; run_i++) thread_count += params[run_i].threads;
+        result->thread_counters = (Phase_Counters *)arena_push(arena, thread_count *
+                                                                      sizeof(Phase_Counters));
+        result->thread_count = thread_count;
+        result->counters_available = perf_open()->available;
+        Phase_Counters *thread_counters = result->thread_counters;
+        for (s32 run_i = 0; run_i < runs; run_i++) {
+            for (s32 i = 0; i < params[run_i].threads; i++) {
+                memcpy(thread_counters->values, workspaces[run_i].thread_times[i].counters,
+                       sizeof(thread_counters->values));
+                thread_counters++;
+            }
+        }
+        for (s32 phase = 0; phase < PHASE_COUNT; phase++) {
+            for (s32 counter = 0; counter < COUNTER_COUNT; counter++) {
+                result->thread_counters[0].values[phase][counter] +=
+                    build_times.counters[phase][counter];
+                for (s32 i = 0; i < thread_count; i++) {
+                    result->counters.values[phase][counter] +=
+                        result->thread_counters[i].values[phase][counter];
+                }
+            }
+        }
+    }
+
+    // written after the timing, so the file doesn't count against the solve
+    if (base->trace_path) write_trace(base->trace_path, workspaces, runs);
+    if (base->timeline_path) {
+        write_timeline(base->timeline_path, workspaces, params, runs, pending->start_time);
+    }
+    return true;
+}
+
+bool solve_portfolio(Solver_Context *context, Spectrum *spectrum,
+                     s32 original_oncts, s32 runs, Solve_Params *params,
+                     Solve_Result *result) {
+    *result = Solve_Result{};
+    return begin_solve(context, spectrum, original_oncts, runs, params) &&
+           end_solve(context, result);
+}
+
+bool solve(Solver_Context *context, Spectrum *spectrum, s32 original_oncts,
+           Solve_Params *params, Solve_Result *result) {
+    return solve_portfolio(context, spectrum, original_oncts, 1, params, result);
+}
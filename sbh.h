@@ -0,0 +1,320 @@
+// sbh.h - sequencing by hybridization solver
+//
+// Reconstructs a DNA sequence from its spectrum, the set of oligos of length
+// k it contains, using a genetic algorithm over the overlap graph of the
+// oligos. The spectrum may have negative errors (missing oligos) and positive
+// errors (oligos that don't belong to the sequence). Spectra without positive
+// errors are first tried as an Eulerian path through the de Bruijn graph of the
+// oligos, which takes linear time, and only go to the genetic algorithm when
+// too many oligos are missing for it.
+//
+// All state lives in a Solver_Context, so several threads can solve at the
+// same time as long as each uses its own context. A context keeps its memory
+// between calls and only grows it to the largest solve so far, so solving many
+// spectra with one context doesn't allocate or page fault in steady state.
+//
+//      Solver_Context *context = create_solver_context();
+//      Spectrum spectrum;
+//      if (load_spectrum("Instances/RandomNegativeErrors/9.200-40.txt", &spectrum)) {
+//          Solve_Params params = default_params(seed);
+//          Solve_Result result;
+//          if (solve(context, &spectrum, 200, &params, &result)) {
+//              puts(result.sequence);
+//          }
+//          free_spectrum(&spectrum);
+//      }
+//      free_solver_context(context);
+
+#ifndef SBH_H
+#define SBH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int8_t  s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+//
+// spectrum
+//
+
+// a set of oligos of equal length. oligo i starts at data + i*stride and is
+// not null terminated. when loaded from a text file, data points straight
+// into the mapped file
+struct Spectrum {
+    char *data;
+    s32 stride;
+    s32 onct_length;
+    s32 count;
+
+    // only known for binary spectra, 0 otherwise
+    s32 original_length;
+    u32 error_class;
+
+    void *mapping;
+    size_t mapping_size;
+    char *decoded;
+};
+
+enum Error_Class {
+    ERRORS_UNKNOWN,
+    ERRORS_POSITIVE_WITH_DISTORTIONS,
+    ERRORS_RANDOM_NEGATIVE,
+    ERRORS_RANDOM_POSITIVE,
+    ERRORS_REPETITION_NEGATIVE,
+};
+
+//
+// binary spectrum file: a header followed by count packed oligos. every oligo
+// takes (onct_length+3)/4 bytes, 2 bits per nucleotide, first nucleotide in
+// the highest bits. with SPECTRUM_SORTED the oligos are sorted and unique
+//
+
+#define SPECTRUM_MAGIC   0x31484253 // "SBH1"
+#define SPECTRUM_VERSION 1
+#define SPECTRUM_SORTED  1
+
+struct Spectrum_Header {
+    u32 magic;
+    u32 version;
+    u32 onct_length;
+    u32 count;
+    u32 original_length; // number of oligos in the original sequence
+    u32 error_class;
+    u32 flags;
+    u32 checksum; // crc32 of the packed oligos
+};
+
+inline char * spectrum_oligo(Spectrum *spectrum, s32 index) {
+    return spectrum->data + (size_t)index * spectrum->stride;
+}
+
+// maps a spectrum file. binary spectra are recognized by their magic number,
+// everything else is read as text with one oligo per line
+bool load_spectrum(char *path, Spectrum *out);
+void free_spectrum(Spectrum *spectrum);
+
+// decodes a binary spectrum held in memory, name is only used in messages. the
+// oligos are copied out, so data can go away afterwards
+bool read_binary_spectrum(char *name, void *data, size_t size, Spectrum *out);
+
+// writes a spectrum in the binary format. sorting also drops duplicates
+bool write_binary_spectrum(char *path, Spectrum *spectrum, s32 original_length,
+                           u32 error_class, bool sorted);
+
+// reads a FASTA or FASTQ file, optionally gzip compressed, into a spectrum of
+// its k-mers. original_length is set to the number of k-mers of the sequence
+// when the file holds a single record
+bool ingest_file(char *path, s32 onct_length, bool canonical,
+                 Spectrum *out, s32 *original_length);
+
+//
+// solver
+//
+
+struct Solve_Params {
+    s32 population;
+    s32 generations;
+    s32 parent_count;
+    s32 mutations;
+    bool breed;
+    u64 seed;
+    s32 threads; // size of the team used inside one run, 0 for all cores
+
+    // the oligos may come from either strand, like the canonical k-mers of
+    // ingest_file. every oligo is then used once, forward or reverse
+    // complemented, and the solver takes half as many
+    bool double_stranded;
+
+    // when set, best, mean and median score, diversity and elapsed time of
+    // every generation are written to this file as csv
+    char *trace_path;
+
+    // when set, a chrome trace (chrome://tracing, Perfetto) of what every
+    // thread did in the last generations is written to this file
+    char *timeline_path;
+
+    // replace the generations by a steady state loop: every thread breeds
+    // children from tournament winners and puts them in place of tournament
+    // losers, without sorting or waiting for the others. makes as many
+    // children as the generations would. trace and checkpoints only cover the
+    // generational loop
+    bool steady_state;
+
+    // run on the task pool (see task_parallel_for) instead of OpenMP teams:
+    // the portfolio runs, the overlaps of the graph and every loop of the GA
+    // become tasks that idle workers steal, so children of uneven repair cost
+    // balance out. the runs share all workers and threads is ignored
+    bool tasks;
+
+    // when set, the population is saved to this file every checkpoint_every
+    // generations, from a thread of its own so the run doesn't wait for it.
+    // the runs of a portfolio add .N to the path. the file is removed when the
+    // run ends, so only interrupted runs leave one behind
+    char *checkpoint_path;
+    s32 checkpoint_every;
+    // continue from the checkpoint instead of a new population. a checkpoint
+    // of another spectrum or other parameters is ignored. random streams are
+    // not saved but seeded per generation and thread, so a resumed run only
+    // continues the way the interrupted one would have with the same team
+    // size. with tasks the streams don't depend on it
+    bool resume;
+};
+
+// parts of a solve that are timed separately
+enum Phase {
+    PHASE_LOAD,           // not timed by solve, left for the caller
+    PHASE_DE_BRUIJN,      // the Eulerian path fast path
+    PHASE_OVERLAP,        // building the edges of the graph
+    PHASE_EDGE_SORT,
+    PHASE_OPTIMIZE_GRAPH,
+    PHASE_INIT,           // creating and scoring the first population
+    PHASE_SELECTION,      // sorting the scores and saving the parents
+    PHASE_CROSSOVER,      // breeding and mutation
+    PHASE_SCORING,
+    PHASE_COUNT,
+};
+
+char * phase_name(s32 phase);
+
+// hardware counters read per phase with CONTEXT_COUNTERS (linux perf events)
+enum Counter {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_DTLB_MISSES,
+    COUNTER_COUNT,
+};
+
+char * counter_name(s32 counter);
+
+struct Phase_Counters {
+    u64 values[PHASE_COUNT][COUNTER_COUNT];
+};
+
+// the buffers of a result belong to the context that produced it and stay
+// valid until its next solve
+struct Solve_Result {
+    s32 *path;       // indices of the used oligos, in order
+    u8 *strands;     // per path entry, 1 where the oligo was reverse complemented.
+                     // only for double stranded solves, 0 otherwise
+    s32 path_length; // equal to score
+    char *sequence;  // null terminated
+    s32 sequence_length;
+
+    s32 score;       // number of oligos used
+    s32 optimal_score;
+    double percent_score;
+    s32 generations; // generations run by the best run
+    s32 resumed_from; // generation the best run continued at, 0 when it started over
+    bool de_bruijn;  // solved by the fast path, without the genetic algorithm
+    double elapsed_ms;
+    double phase_ms[PHASE_COUNT]; // summed over all threads and runs
+    s64 cache_lookups; // children looked up in the fitness cache
+    s64 cache_hits;    // of them, copies of a candidate scored the same generation
+
+    // only with CONTEXT_COUNTERS. counters the system doesn't allow stay 0
+    u32 counters_available; // bit per Counter
+    Phase_Counters counters; // summed over all threads and runs
+    Phase_Counters *thread_counters; // per thread of every run
+    s32 thread_count;
+
+    size_t memory_size; // bytes held by the context
+    bool memory_grown;  // the context had to allocate for this solve
+    u32 huge_pages;     // HUGE_PAGES_ kind the memory was allocated with
+    size_t huge_page_bytes; // bytes of it actually backed by huge pages
+};
+
+struct Solver_Context;
+
+// fault all memory of the context in when it is allocated, instead of on first
+// touch during the solve (MAP_POPULATE, linux only)
+#define CONTEXT_POPULATE 1
+// back the population and the graph with 2 MB pages to cut TLB misses on big
+// spectra. falls back to normal pages when none are available
+#define CONTEXT_HUGE_PAGES 2
+
+// place memory for multi-socket machines: every thread first touches its own
+// part of the population and every NUMA node gets a copy of the graph. the
+// pages are dropped and faulted in again by their owners at every solve, and
+// CONTEXT_POPULATE is ignored. bind the threads for it to pay off, for example
+// with OMP_PROC_BIND=spread OMP_PLACES=cores
+#define CONTEXT_NUMA 4
+
+// count cycles, instructions, cache, branch and TLB misses of every phase per
+// thread. reading the counters costs a system call per timed scope
+#define CONTEXT_COUNTERS 8
+
+enum Huge_Pages {
+    HUGE_PAGES_NONE,
+    HUGE_PAGES_TRANSPARENT, // madvise(MADV_HUGEPAGE), the kernel may still refuse
+    HUGE_PAGES_RESERVED,    // MAP_HUGETLB or MEM_LARGE_PAGES
+};
+
+Solver_Context * create_solver_context(u32 flags = 0);
+void free_solver_context(Solver_Context *context);
+
+Solve_Params default_params(u64 seed);
+
+// original_oncts is the number of oligos in the original sequence, which
+// limits the length of the solution
+bool solve(Solver_Context *context, Spectrum *spectrum, s32 original_oncts,
+           Solve_Params *params, Solve_Result *result);
+
+// runs independent solver instances with different seeds and parameter sets
+// and keeps the best result. params->threads cores are split between the runs.
+// every run has an OpenMP team inside the team of runs, so the caller has to
+// allow two more active levels than it is in (omp_set_max_active_levels),
+// otherwise each run gets a single thread
+bool solve_portfolio(Solver_Context *context, Spectrum *spectrum,
+                     s32 original_oncts, s32 runs, Solve_Params *params,
+                     Solve_Result *result);
+
+// the two halves of solve_portfolio, so a caller can build the next graph in
+// one context while another one runs the GA. begin_solve loads the spectrum
+// into the context and builds its graph, or solves it right away when the fast
+// path takes it. end_solve runs the GA and fills result. the spectrum and the
+// paths in params have to stay valid until end_solve, params itself is copied.
+// elapsed_ms leaves out the time between the two
+bool begin_solve(Solver_Context *context, Spectrum *spectrum, s32 original_oncts,
+                 s32 runs, Solve_Params *params);
+bool end_solve(Solver_Context *context, Solve_Result *result);
+
+s32 core_count();
+
+//
+// tasks
+//
+
+// work stealing pool of one std::thread per core, shared by everything in the
+// process. solves with Solve_Params.tasks run their loops on it
+typedef void Task_Function(void *data, s64 begin, s64 end);
+
+// calls function on pieces of at most grain items that together cover
+// [begin, end), on the workers of the pool, and returns when all are done.
+// ranges are halved as idle workers steal them, so pieces of uneven cost
+// balance out. may be called from inside a piece, the waiting worker runs
+// pieces of this loop and of loops nested in them meanwhile
+void task_parallel_for(s64 begin, s64 end, s64 grain, Task_Function *function, void *data);
+
+template <typename F>
+void task_parallel_for(s64 begin, s64 end, s64 grain, F function) {
+    task_parallel_for(begin, end, grain, [](void *data, s64 begin, s64 end) {
+        (*(F *)data)(begin, end);
+    }, &function);
+}
+
+s32 task_worker_count();
+// index of the calling worker of the pool, -1 for other threads
+s32 task_worker_index();
+
+#endif // SBH_H
@@ -0,0 +1,628 @@
+// spectrum loading: mapped text files, the packed binary format and FASTA/FASTQ
+// ingestion
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+
+// memory mapped files
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "stb.h"
+
+// gzip decoder for compressed FASTA/FASTQ input
+#define INFLATE_IMPL
+#include "inflate.h"
+
+#include "sbh.h"
+
+inline s32 packed_oligo_size(s32 onct_length) {
+    return (onct_length + 3) / 4;
+}
+
+u8 nucleotide_code(char c) {
+    switch (c) {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        default:  return 3;
+    }
+}
+
+void pack_oligo(char *oligo, s32 onct_length, u8 *out) {
+    memset(out, 0, packed_oligo_size(onct_length));
+    for (s32 i = 0; i < onct_length; i++) {
+        out[i/4] |= nucleotide_code(oligo[i]) << (6 - 2*(i%4));
+    }
+}
+
+void unpack_oligo(u8 *packed, s32 onct_length, char *out) {
+    static char nucleotides[] = "ACGT";
+    for (s32 i = 0; i < onct_length; i++) {
+        out[i] = nucleotides[(packed[i/4] >> (6 - 2*(i%4))) & 3];
+    }
+}
+
+void * map_file(char *path, size_t *size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER file_size;
+    void *result = 0;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if (mapping) {
+            result = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            *size = (size_t)file_size.QuadPart;
+        }
+    }
+    CloseHandle(file);
+    return result;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat file_stat;
+    void *result = 0;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        result = mmap(0, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (result == MAP_FAILED) {
+            result = 0;
+        } else {
+            *size = file_stat.st_size;
+        }
+    }
+    close(fd);
+    return result;
+#endif
+}
+
+void unmap_file(void *data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+// far longer than any oligo of a chip. binary spectra may come from clients of
+// seq -serve, so the header is checked against it before anything is sized
+#define SPECTRUM_MAX_ONCT_LENGTH 1024
+
+// unpacks a mapped binary spectrum into a single buffer of oligos
+bool decode_binary_spectrum(char *path, u8 *data, size_t size, Spectrum *out) {
+    Spectrum_Header *header = (Spectrum_Header *)data;
+    u8 *packed = data + sizeof(Spectrum_Header);
+    s32 onct_length = header->onct_length;
+    bool valid = header->version == SPECTRUM_VERSION &&
+                 onct_length > 0 && onct_length <= SPECTRUM_MAX_ONCT_LENGTH &&
+                 header->count > 0 && header->count < 0x7fffffff;
+    s32 packed_size = valid ? packed_oligo_size(onct_length) : 0;
+    u64 packed_total = (u64)header->count * packed_size;
+    valid = valid && packed_total == size - sizeof(Spectrum_Header);
+    if (valid && stb_crc32(packed, (stb_uint)packed_total) != header->checksum) {
+        fprintf(stderr, "%s: checksum mismatch\n", path);
+        return false;
+    }
+    if (!valid) {
+        fprintf(stderr, "%s: malformed binary spectrum\n", path);
+        return false;
+    }
+
+    Spectrum result = {};
+    result.onct_length = onct_length;
+    result.stride = onct_length;
+    result.count = header->count;
+    result.original_length = header->original_length;
+    result.error_class = header->error_class;
+    result.decoded = (char *)malloc((size_t)result.count * onct_length);
+    if (!result.decoded) {
+        fprintf(stderr, "%s: can't allocate %d oligos\n", path, result.count);
+        return false;
+    }
+    result.data = result.decoded;
+    for (s32 i = 0; i < result.count; i++) {
+        unpack_oligo(packed + (size_t)i*packed_size, onct_length,
+                     spectrum_oligo(&result, i));
+    }
+    *out = result;
+    return true;
+}
+
+// a binary spectrum already in memory, such as one sent to seq -serve
+bool read_binary_spectrum(char *name, void *data, size_t size, Spectrum *out) {
+    if (size < sizeof(Spectrum_Header) || ((Spectrum_Header *)data)->magic != SPECTRUM_MAGIC) {
+        fprintf(stderr, "%s: not a binary spectrum\n", name);
+        return false;
+    }
+    return decode_binary_spectrum(name, (u8 *)data, size, out);
+}
+
+// maps a spectrum file. binary spectra are recognized by their magic number,
+// everything else is read as text with one oligo per line. all lines must
+// have the same length and consist of ACGT only. nothing is copied or
+// allocated per line, the oligos are used in place
+bool load_spectrum(char *path, Spectrum *out) {
+    Spectrum result = {};
+    size_t size = 0;
+    char *data = (char *)map_file(path, &size);
+    if (!data) {
+        fprintf(stderr, "%s: can't map file\n", path);
+        return false;
+    }
+    if (size >= sizeof(Spectrum_Header) &&
+        ((Spectrum_Header *)data)->magic == SPECTRUM_MAGIC)
+    {
+        bool ok = decode_binary_spectrum(path, (u8 *)data, size, out);
+        unmap_file(data, size);
+        return ok;
+    }
+    result.data = data;
+    result.mapping = data;
+    result.mapping_size = size;
+
+    // the first line decides the oligo length and the line ending
+    s32 onct_length = 0;
+    while ((size_t)onct_length < size && data[onct_length] != '\n'
+           && data[onct_length] != '\r') {
+        onct_length++;
+    }
+    s32 stride = onct_length + 1;
+    if ((size_t)onct_length + 1 < size && data[onct_length] == '\r') {
+        stride++;
+    }
+
+    // the last line may lack its line ending
+    size_t count = size / stride;
+    size_t remainder = size % stride;
+    if (remainder == (size_t)onct_length) {
+        count++;
+    } else if (remainder != 0) {
+        count = 0;
+    }
+
+    bool valid = onct_length > 0 && count > 0 && count < 0x7fffffff;
+    for (size_t i = 0; valid && i < count; i++) {
+        char *line = data + i*stride;
+        for (s32 j = 0; j < onct_length; j++) {
+            char c = line[j];
+            if (c != 'A' && c != 'C' && c != 'G' && c != 'T') {
+                valid = false;
+                break;
+            }
+        }
+        if (valid && (i+1)*stride <= size) {
+            valid = line[stride-1] == '\n' &&
+                    (stride == onct_length+1 || line[onct_length] == '\r');
+        }
+    }
+    if (!valid) {
+        fprintf(stderr, "%s: not a spectrum of fixed length ACGT lines\n", path);
+        unmap_file(data, size);
+        return false;
+    }
+
+    result.stride = stride;
+    result.onct_length = onct_length;
+    result.count = (s32)count;
+    *out = result;
+    return true;
+}
+
+void free_spectrum(Spectrum *spectrum) {
+    if (spectrum->mapping) {
+        unmap_file(spectrum->mapping, spectrum->mapping_size);
+    }
+    free(spectrum->decoded);
+    *spectrum = Spectrum{};
+}
+
+// writes a spectrum in the binary format. sorting also drops duplicates
+bool write_binary_spectrum(char *path, Spectrum *spectrum, s32 original_length,
+                           u32 error_class, bool sorted) {
+    s32 onct_length = spectrum->onct_length;
+    s32 packed_size = packed_oligo_size(onct_length);
+    u8 *packed = (u8 *)malloc((size_t)spectrum->count * packed_size);
+    for (s32 i = 0; i < spectrum->count; i++) {
+        pack_oligo(spectrum_oligo(spectrum, i), onct_length,
+                   packed + (size_t)i*packed_size);
+    }
+
+    s32 count = spectrum->count;
+    if (sorted) {
+        // the packed codes keep the alphabetical order of the oligos
+        s32 *order = (s32 *)malloc(count * sizeof(s32));
+        for (s32 i = 0; i < count; i++) order[i] = i;
+        std::sort(order, order + count, [=](s32 a, s32 b) {
+            return memcmp(packed + (size_t)a*packed_size,
+                          packed + (size_t)b*packed_size, packed_size) < 0;
+        });
+        u8 *sorted_packed = (u8 *)malloc((size_t)count * packed_size);
+        s32 unique = 0;
+        for (s32 i = 0; i < count; i++) {
+            u8 *oligo = packed + (size_t)order[i]*packed_size;
+            u8 *last = sorted_packed + (size_t)(unique-1)*packed_size;
+            if (unique == 0 || memcmp(oligo, last, packed_size)) {
+                memcpy(sorted_packed + (size_t)unique*packed_size, oligo, packed_size);
+                unique++;
+            }
+        }
+        free(order);
+        free(packed);
+        packed = sorted_packed;
+        count = unique;
+    }
+
+    Spectrum_Header header = {};
+    header.magic = SPECTRUM_MAGIC;
+    header.version = SPECTRUM_VERSION;
+    header.onct_length = onct_length;
+    header.count = count;
+    header.original_length = original_length;
+    header.error_class = error_class;
+    header.flags = sorted ? SPECTRUM_SORTED : 0;
+    header.checksum = stb_crc32(packed, (stb_uint)((size_t)count * packed_size));
+
+    FILE *f = fopen(path, "wb");
+    bool ok = f != 0;
+    if (ok) {
+        ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(packed, packed_size, count, f) == (size_t)count;
+        ok = fclose(f) == 0 && ok;
+    }
+    if (!ok) fprintf(stderr, "%s: can't write file\n", path);
+    free(packed);
+    return ok;
+}
+
+//
+// FASTA/FASTQ ingestion. the input is read in chunks (through inflate.h for
+// gzip files) and cut into k-mers with a rolling 2-bit code. the k-mers are
+// deduplicated in a concurrent hash set, which then becomes the spectrum
+//
+
+#define INGEST_CHUNK_SIZE (1 << 20)
+#define INGEST_BATCH_SIZE (1 << 22) // bases extracted in parallel at once
+#define INGEST_UNIT_SIZE  (1 << 16) // bases in one parallel work unit
+#define INGEST_MAX_K      31        // codes are stored +1 in 64 bits
+
+// open addressing set of k-mer codes. slots hold code+1, 0 means empty.
+// inserts are lock free, growing only happens between batches
+struct Kmer_Set {
+    std::atomic<u64> *slots;
+    u64 capacity;
+    std::atomic<u64> count;
+};
+
+inline u64 hash_kmer(u64 code) {
+    code ^= code >> 33;
+    code *= 0xFF51AFD7ED558CCDull;
+    code ^= code >> 33;
+    code *= 0xC4CEB9FE1A85EC53ull;
+    code ^= code >> 33;
+    return code;
+}
+
+void kmer_set_insert(Kmer_Set *set, u64 code) {
+    u64 key = code + 1;
+    u64 mask = set->capacity - 1;
+    for (u64 slot = hash_kmer(code) & mask;; slot = (slot + 1) & mask) {
+        u64 current = set->slots[slot].load(std::memory_order_relaxed);
+        if (current == 0 &&
+            set->slots[slot].compare_exchange_strong(current, key,
+                                                     std::memory_order_relaxed))
+        {
+            set->count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // on a failed exchange current holds the key that won the slot
+        if (current == key) return;
+    }
+}
+
+// makes room for extra more k-mers at a load factor of at most 1/2
+void kmer_set_reserve(Kmer_Set *set, u64 extra) {
+    u64 needed = 2 * (set->count.load() + extra);
+    if (needed <= set->capacity) return;
+    u64 capacity = stb_max(set->capacity, 1024);
+    while (capacity < needed) capacity *= 2;
+
+    Kmer_Set grown;
+    grown.slots = new std::atomic<u64>[capacity]();
+    grown.capacity = capacity;
+    grown.count = 0;
+    for (u64 i = 0; i < set->capacity; i++) {
+        u64 key = set->slots[i].load(std::memory_order_relaxed);
+        if (key) kmer_set_insert(&grown, key - 1);
+    }
+    delete[] set->slots;
+    set->slots = grown.slots;
+    set->capacity = capacity;
+}
+
+enum Ingest_State {
+    INGEST_RECORD_START,
+    INGEST_HEADER,
+    INGEST_SEQUENCE,
+    INGEST_SEPARATOR, // the '+' line of a FASTQ record
+    INGEST_QUALITY,
+    INGEST_ERROR,
+};
+
+struct Ingest {
+    s32 onct_length;
+    bool canonical; // store the smaller of a k-mer and its reverse complement
+
+    s32 state;
+    bool line_start;
+    char record_marker; // '>' for FASTA, '@' for FASTQ
+    s64 record_bases;
+    s64 quality_left;
+    s64 record_count;
+
+    // bases waiting for extraction. segments holds [start, end) pairs of the
+    // runs of bases that belong to one record
+    char *batch;
+    s64 batch_length;
+    s64 segment_start;
+    s64 *segments;
+
+    Kmer_Set set;
+};
+
+void extract_kmers(Ingest *ingest, char *bases, s64 length) {
+    s32 k = ingest->onct_length;
+    u64 mask = (1ull << (2*k)) - 1;
+    u64 forward = 0;
+    u64 reverse = 0;
+    s32 valid = 0;
+    for (s64 i = 0; i < length; i++) {
+        char c = bases[i];
+        if (c != 'A' && c != 'C' && c != 'G' && c != 'T') {
+            valid = 0;
+            continue;
+        }
+        u64 code = nucleotide_code(c);
+        forward = ((forward << 2) | code) & mask;
+        reverse = (reverse >> 2) | ((3 - code) << (2*(k-1)));
+        if (++valid < k) continue;
+        if (ingest->canonical && reverse < forward) {
+            kmer_set_insert(&ingest->set, reverse);
+        } else {
+            kmer_set_insert(&ingest->set, forward);
+        }
+    }
+}
+
+void ingest_close_segment(Ingest *ingest) {
+    if (ingest->batch_length > ingest->segment_start) {
+        stb_arr_push(ingest->segments, ingest->segment_start);
+        stb_arr_push(ingest->segments, ingest->batch_length);
+    }
+    ingest->segment_start = ingest->batch_length;
+}
+
+// extracts the k-mers of the whole batch. when a record continues past the
+// batch, its last k-1 bases are kept so that no k-mer is lost at the seam
+void ingest_flush_batch(Ingest *ingest, bool in_record) {
+    s32 k = ingest->onct_length;
+    s64 open_start = ingest->segment_start;
+    ingest_close_segment(ingest);
+
+    // long records are split into units that overlap by k-1 bases
+    s64 *units = 0;
+    for (s32 i = 0; i < stb_arr_len(ingest->segments); i += 2) {
+        s64 start = ingest->segments[i];
+        s64 end = ingest->segments[i+1];
+        for (s64 unit = start; unit + k <= end; unit += INGEST_UNIT_SIZE) {
+            stb_arr_push(units, unit);
+            stb_arr_push(units, stb_min(unit + INGEST_UNIT_SIZE + k - 1, end));
+        }
+    }
+    kmer_set_reserve(&ingest->set, ingest->batch_length);
+
+    s32 unit_count = stb_arr_len(units) / 2;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (s32 unit_i = 0; unit_i < unit_count; unit_i++) {
+        s64 start = units[2*unit_i];
+        s64 end = units[2*unit_i + 1];
+        extract_kmers(ingest, ingest->batch + start, end - start);
+    }
+    stb_arr_free(units);
+    stb_arr_setlen(ingest->segments, 0);
+
+    s64 carry = 0;
+    if (in_record) {
+        carry = stb_min(k-1, ingest->batch_length - open_start);
+        memmove(ingest->batch, ingest->batch + ingest->batch_length - carry, carry);
+    }
+    ingest->batch_length = carry;
+    ingest->segment_start = 0;
+}
+
+void ingest_end_record(Ingest *ingest) {
+    ingest_close_segment(ingest);
+    ingest->record_count++;
+    ingest->state = INGEST_RECORD_START;
+}
+
+void ingest_feed(Ingest *ingest, char *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        char c = data[i];
+        bool newline = c == '\n' || c == '\r';
+        switch (ingest->state) {
+            case INGEST_RECORD_START: {
+                if (newline) break;
+                if (!ingest->record_marker && (c == '>' || c == '@')) {
+                    ingest->record_marker = c;
+                }
+                if (c != ingest->record_marker) {
+                    ingest->state = INGEST_ERROR;
+                    break;
+                }
+                ingest->record_bases = 0;
+                ingest->state = INGEST_HEADER;
+            } break;
+
+            case INGEST_HEADER: {
+                if (c == '\n') {
+                    ingest->state = INGEST_SEQUENCE;
+                    ingest->line_start = true;
+                }
+            } break;
+
+            case INGEST_SEQUENCE: {
+                if (newline) {
+                    ingest->line_start = true;
+                    break;
+                }
+                if (ingest->line_start) {
+                    ingest->line_start = false;
+                    if (c == '>' && ingest->record_marker == '>') {
+                        ingest_end_record(ingest);
+                        ingest->record_bases = 0;
+                        ingest->state = INGEST_HEADER;
+                        break;
+                    }
+                    if (c == '+' && ingest->record_marker == '@') {
+                        ingest->quality_left = ingest->record_bases;
+                        ingest->state = INGEST_SEPARATOR;
+                        break;
+                    }
+                }
+                if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+                ingest->batch[ingest->batch_length++] = c;
+                ingest->record_bases++;
+                if (ingest->batch_length == INGEST_BATCH_SIZE) {
+                    ingest_flush_batch(ingest, true);
+                }
+            } break;
+
+            case INGEST_SEPARATOR: {
+                if (c == '\n') {
+                    ingest->state = INGEST_QUALITY;
+                    if (ingest->quality_left == 0) ingest_end_record(ingest);
+                }
+            } break;
+
+            case INGEST_QUALITY: {
+                if (newline) break;
+                if (--ingest->quality_left == 0) ingest_end_record(ingest);
+            } break;
+
+            case INGEST_ERROR: return;
+        }
+    }
+}
+
+void ingest_sink(void *user, unsigned char *data, size_t size) {
+    ingest_feed((Ingest *)user, (char *)data, size);
+}
+
+// reads a FASTA or FASTQ file, optionally gzip compressed, into a spectrum of
+// its k-mers. original_length is set to the number of k-mers of the sequence
+// when the file holds a single record
+bool ingest_file(char *path, s32 onct_length, bool canonical,
+                 Spectrum *out, s32 *original_length) {
+    if (onct_length < 2 || onct_length > INGEST_MAX_K) {
+        fprintf(stderr, "k must be between 2 and %d\n", INGEST_MAX_K);
+        return false;
+    }
+
+    Ingest ingest = {};
+    ingest.onct_length = onct_length;
+    ingest.canonical = canonical;
+    ingest.batch = (char *)malloc(INGEST_BATCH_SIZE);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "%s: can't open file\n", path);
+        free(ingest.batch);
+        return false;
+    }
+    u8 magic[2] = {};
+    size_t magic_size = fread(magic, 1, 2, f);
+    bool gzip = magic_size == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+
+    bool ok = true;
+    if (gzip) {
+        fclose(f);
+        size_t size = 0;
+        u8 *data = (u8 *)map_file(path, &size);
+        ok = data && inflate_gzip(data, size, ingest_sink, &ingest) == 0;
+        if (data) unmap_file(data, size);
+        if (!ok) fprintf(stderr, "%s: corrupt gzip file\n", path);
+    } else {
+        ingest_feed(&ingest, (char *)magic, magic_size);
+        char *chunk = (char *)malloc(INGEST_CHUNK_SIZE);
+        size_t read;
+        while ((read = fread(chunk, 1, INGEST_CHUNK_SIZE, f)) > 0) {
+            ingest_feed(&ingest, chunk, read);
+        }
+        free(chunk);
+        fclose(f);
+    }
+
+    if (ingest.state == INGEST_SEQUENCE) ingest_end_record(&ingest);
+    if (ok && ingest.state != INGEST_RECORD_START) {
+        fprintf(stderr, "%s: not a FASTA or FASTQ file\n", path);
+        ok = false;
+    }
+    s64 last_record_bases = ingest.record_bases;
+    ingest_flush_batch(&ingest, false);
+
+    u64 count = ingest.set.count;
+    if (ok && (count == 0 || count >= 0x7fffffff)) {
+        fprintf(stderr, "%s: no usable k-mers\n", path);
+        ok = false;
+    }
+    if (ok) {
+        // sorted, so that the same input always gives the same spectrum
+        u64 *codes = (u64 *)malloc(count * sizeof(u64));
+        u64 code_count = 0;
+        for (u64 i = 0; i < ingest.set.capacity; i++) {
+            u64 key = ingest.set.slots[i].load(std::memory_order_relaxed);
+            if (key) codes[code_count++] = key - 1;
+        }
+        std::sort(codes, codes + code_count);
+
+        Spectrum result = {};
+        result.onct_length = onct_length;
+        result.stride = onct_length;
+        result.count = (s32)code_count;
+        result.decoded = (char *)malloc(code_count * onct_length);
+        result.data = result.decoded;
+        static char nucleotides[] = "ACGT";
+        for (u64 i = 0; i < code_count; i++) {
+            char *oligo = spectrum_oligo(&result, (s32)i);
+            for (s32 j = 0; j < onct_length; j++) {
+                oligo[j] = nucleotides[(codes[i] >> (2*(onct_length-1-j))) & 3];
+            }
+        }
+        free(codes);
+        *out = result;
+
+        *original_length = 0;
+        if (ingest.record_count == 1 && last_record_bases >= onct_length) {
+            *original_length = (s32)(last_record_bases - onct_length + 1);
+        }
+    }
+
+    delete[] ingest.set.slots;
+    stb_arr_free(ingest.segments);
+    free(ingest.batch);
+    return ok;
+}
+